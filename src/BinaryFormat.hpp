@@ -0,0 +1,262 @@
+#ifndef _FHE_BINARY_FORMAT
+#define _FHE_BINARY_FORMAT
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+
+// Primitives of the binary circuit format (see CircuitCache.hpp)
+
+static const char MAGIC[8] = {'F', 'H', 'E', 'C', 'G', 'R', 'P', 'H'};
+static const size_t FILE_HEADER_SIZE = 24, GRAPH_HEADER_SIZE = 24;
+
+inline bool hostIsLittleEndian()
+{
+    const uint16_t one = 1;
+    return *reinterpret_cast<const uint8_t *>(&one) == 1;
+}
+
+inline uint32_t swapBytes(const uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+inline uint64_t swapBytes(const uint64_t v)
+{
+    return ((uint64_t)swapBytes((uint32_t)v) << 32) |
+           swapBytes((uint32_t)(v >> 32));
+}
+
+inline size_t align8(const size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+// Buffered little-endian output
+class BinaryOutput
+{
+private:
+    FILE *fp;
+    size_t pos = 0;
+    std::vector<int32_t> buf;
+
+public:
+    BinaryOutput(FILE *_fp) : fp(_fp){};
+
+    void bytes(const void *p, const size_t n)
+    {
+        if (fwrite(p, 1, n, fp) != n)
+            throw std::runtime_error("cannot write binary circuit");
+        pos += n;
+    }
+    void u64(uint64_t v)
+    {
+        flush();
+        if (!hostIsLittleEndian())
+            v = swapBytes(v);
+        bytes(&v, sizeof(v));
+    }
+    // collected ints are written in blocks
+    void i32(const int32_t v)
+    {
+        buf.push_back(hostIsLittleEndian() ? v
+                                           : (int32_t)swapBytes((uint32_t)v));
+        if (buf.size() >= (1 << 16))
+            flush();
+    }
+    void flush()
+    {
+        if (!buf.empty())
+            bytes(buf.data(), buf.size() * sizeof(int32_t));
+        buf.clear();
+    }
+    // pad with zeros to the next multiple of 8 bytes
+    void align()
+    {
+        flush();
+        static const char zero[8] = {};
+        bytes(zero, align8(pos) - pos);
+    }
+};
+
+// Bounds checked little-endian input over a mapping
+class BinaryInput
+{
+private:
+    const char *p, *end;
+
+public:
+    BinaryInput(const char *_begin, const char *_end) : p(_begin), end(_end){};
+
+    bool has(const size_t n) const
+    {
+        return (size_t)(end - p) >= n;
+    }
+    const char *take(const size_t n)
+    {
+        const char *q = p;
+        p += n;
+        return q;
+    }
+    uint64_t u64()
+    {
+        uint64_t v;
+        memcpy(&v, take(sizeof(v)), sizeof(v));
+        return hostIsLittleEndian() ? v : swapBytes(v);
+    }
+    int32_t i32()
+    {
+        uint32_t v;
+        memcpy(&v, take(sizeof(v)), sizeof(v));
+        return hostIsLittleEndian() ? v : swapBytes(v);
+    }
+    // an array of n int32, followed by padding up to 8 bytes
+    const char *array(const size_t n)
+    {
+        return take(align8(n * sizeof(int32_t)));
+    }
+};
+
+inline int32_t loadInt(const char *array, const size_t i)
+{
+    uint32_t v;
+    memcpy(&v, array + i * sizeof(v), sizeof(v));
+    return hostIsLittleEndian() ? v : swapBytes(v);
+}
+
+// one graph of a binary circuit, arrays in place
+struct BinaryGraph
+{
+    int32_t n_gate, n_wire, n_input, n_output;
+    long n_slot, n_dest;
+    const char *gates, *src, *dest_begin, *dests;
+};
+
+// the file header; false if it is not a binary circuit of this version
+inline bool readFileHeader(BinaryInput &in, const uint32_t version,
+                           int &n_graphs, uint64_t &key)
+{
+    if (!in.has(FILE_HEADER_SIZE) || memcmp(in.take(8), MAGIC, 8) != 0)
+        return false;
+    if ((uint32_t)in.i32() != version)
+        return false;
+    n_graphs = in.i32();
+    key = in.u64();
+    return true;
+}
+
+// the next graph; false if it is truncated
+inline bool readGraph(BinaryInput &in, BinaryGraph &g)
+{
+    if (!in.has(GRAPH_HEADER_SIZE))
+        return false;
+    g.n_gate = in.i32();
+    g.n_wire = in.i32();
+    g.n_input = in.i32();
+    g.n_output = in.i32();
+    g.n_slot = in.i32();
+    g.n_dest = in.i32();
+    if (g.n_gate < 0 || g.n_slot < 0 || g.n_dest < 0 ||
+        !in.has(align8(16L * g.n_gate) + align8(4L * g.n_slot) +
+                align8(4L * (g.n_slot + 1)) + align8(4L * g.n_dest)))
+        return false;
+
+    g.gates = in.array(4L * g.n_gate);
+    g.src = in.array(g.n_slot);
+    g.dest_begin = in.array(g.n_slot + 1);
+    g.dests = in.array(g.n_dest);
+    return true;
+}
+
+// why g is not a graph that can be indexed safely (nullptr if it is), in
+// passes over the arrays that allocate nothing: the counts (the outputs are
+// the last wires and have sources), the wires of gates (an INV has no second
+// operand, -1, or the sentinel wire), the sources (every wire but the inputs
+// has one, and those none), the fan-out offsets and the fan-outs. A gate is
+// also the source of its output (but for the gates that read and write an
+// input wire in a reduced graph), the source of a wire writes it, and the
+// fan-outs of the wires are the gates that read them. Readers of a graph
+// that passes index nothing out of bounds; cycles are left to them
+inline const char *checkGraph(const BinaryGraph &g)
+{
+    auto inRange = [](long v, long lo, long hi) { return lo <= v && v < hi; };
+    const long n_slot = g.n_slot;
+    if (!inRange(g.n_wire, n_slot - 1, n_slot + 1) ||
+        !inRange(g.n_input, 0, g.n_wire + 1) ||
+        !inRange(g.n_output, 0, g.n_wire - g.n_input + 1))
+        return "inconsistent header";
+    for (long i = 0; i < g.n_gate; i++)
+    {
+        const int type = loadInt(g.gates, 4 * i + 3);
+        if (!inRange(type, XOR, IN) ||
+            !inRange(loadInt(g.gates, 4 * i), 0, g.n_wire) ||
+            !inRange(loadInt(g.gates, 4 * i + 1), type == INV ? -1 : 0,
+                     type == INV ? n_slot : g.n_wire) ||
+            !inRange(loadInt(g.gates, 4 * i + 2), 0, g.n_wire))
+            return "gate out of range";
+    }
+    for (long w = 0; w < n_slot; w++)
+    {
+        const int src = loadInt(g.src, w);
+        if (w < g.n_input ? src != -1
+                          : !inRange(src, w == g.n_wire ? -1 : 0, g.n_gate))
+            return "wire source out of range";
+    }
+    for (long w = 0, prev = 0; w <= n_slot; w++)
+    {
+        const int b = loadInt(g.dest_begin, w);
+        if (b < prev || b > g.n_dest)
+            return "fan-out offset out of range";
+        prev = b;
+    }
+    for (long j = 0; j < g.n_dest; j++)
+        if (!inRange(loadInt(g.dests, j), 0, g.n_gate))
+            return "fan-out out of range";
+
+    // the (wire, gate) pairs of the fan-outs and of the gate operands are
+    // compared as multisets through the sum of a hash of each
+    auto pairHash = [](uint64_t w, uint64_t d) {
+        uint64_t h = (w << 32 | d) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h * 0xc4ceb9fe1a85ec53ULL;
+    };
+    uint64_t operands = 0, fanouts = 0;
+    for (long i = 0; i < g.n_gate; i++)
+    {
+        const int in1 = loadInt(g.gates, 4 * i);
+        const int in2 = loadInt(g.gates, 4 * i + 1);
+        const int out = loadInt(g.gates, 4 * i + 2), src = loadInt(g.src, out);
+        if (src == i)
+        {
+            operands += pairHash(in1, i);
+            if (loadInt(g.gates, 4 * i + 3) != INV)
+                operands += pairHash(in2, i);
+        }
+        else if (!(n_slot == g.n_wire && out < g.n_input && src == -1 &&
+                   in1 == out && in2 == out))
+            return "gate is not the source of its output";
+    }
+    for (long w = g.n_input; w < g.n_wire; w++)
+        if (loadInt(g.gates, 4L * loadInt(g.src, w) + 2) != w)
+            return "wire source does not write it";
+    for (long w = 0; w < n_slot; w++)
+        for (long j = loadInt(g.dest_begin, w);
+             j < loadInt(g.dest_begin, w + 1); j++)
+        {
+            const long d = loadInt(g.dests, j);
+            if (loadInt(g.gates, 4 * d) != w &&
+                (loadInt(g.gates, 4 * d + 3) == INV ||
+                 loadInt(g.gates, 4 * d + 1) != w))
+                return "fan-out does not read the wire";
+            fanouts += pairHash(w, d);
+        }
+    if (operands != fanouts)
+        return "fan-outs do not match the gate operands";
+    return nullptr;
+}
+
+#endif // _FHE_BINARY_FORMAT
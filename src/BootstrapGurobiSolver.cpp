@@ -76,8 +76,9 @@ ProblemResult BootstrapGurobiSolver::solve(const int l, const int n,
                 return &Gout[graph.wires[wire_idx].src]; // general
         };
 
-        GRBVar &gin1 = *selectInputGate(graph.gates[i].in1);
-        GRBVar &gin2 = *selectInputGate(graph.gates[i].in2);
+        const Gate g = graph.gate(i);
+        GRBVar &gin1 = *selectInputGate(g.in1);
+        GRBVar &gin2 = *selectInputGate(g.in2);
         GRBVar &gin = Gin[i];
         GRBVar &gout = Gout[i];
         GRBVar &bi = B[i];
@@ -87,14 +88,14 @@ ProblemResult BootstrapGurobiSolver::solve(const int l, const int n,
         model.addGenConstrIndicator(bi, false, gout - gin == 0);
 
         // Constraints (gate specific)
-        if (graph.gates[i].type == AND)
+        if (g.type == AND)
         {
             model.addConstr(gin - gin1 >= 1);
             model.addConstr(gin - gin2 >= 1);
             model.addConstr(gin1 <= (Lmax - 1));
             model.addConstr(gin2 <= (Lmax - 1));
         }
-        else if (graph.gates[i].type == XOR)
+        else if (g.type == XOR)
         {
             model.addConstr(gin - gin1 >= 0);
             model.addConstr(gin - gin2 >= 0);
@@ -105,7 +106,7 @@ ProblemResult BootstrapGurobiSolver::solve(const int l, const int n,
         }
 
         // PV15 paper says output should strictly less than Lmax
-        if (graph.gates[i].out >= graph.n_input - graph.n_wire)
+        if (g.out >= graph.n_input - graph.n_wire)
         {
             model.addConstr(gout <= (Lmax - 1));
         }
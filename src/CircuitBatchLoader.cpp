@@ -0,0 +1,90 @@
+#include "CircuitBatchLoader.hpp"
+
+#include <algorithm>
+
+#include "Parallel.hpp"
+
+CircuitBatchLoader::CircuitBatchLoader(
+  const std::vector<std::string> &_filenames, const load_function &_load,
+  const int num_threads, const int _capacity)
+  : filenames(_filenames), load(_load),
+    capacity(std::max(1, _capacity)), slots(capacity)
+{
+    // more threads than files to prefetch would only wait
+    const size_t nt =
+      std::min<size_t>(resolveThreads(num_threads),
+                       std::min(capacity, filenames.size()));
+    for (size_t t = 0; t < nt; t++)
+        workers.emplace_back(&CircuitBatchLoader::run, this);
+}
+
+CircuitBatchLoader::~CircuitBatchLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopped = true;
+    }
+    cv.notify_all();
+    for (auto &w : workers)
+        w.join();
+}
+
+void CircuitBatchLoader::run()
+{
+    while (true)
+    {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] {
+                return stopped || claimed == filenames.size() ||
+                       claimed < delivered + capacity;
+            });
+            if (stopped || claimed == filenames.size())
+                return;
+            i = claimed++;
+        }
+
+        std::vector<CircuitGraph> graphs;
+        std::exception_ptr error;
+        try
+        {
+            graphs = load(filenames[i]);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        Slot &slot = slots[i % capacity];
+        slot.graphs = std::move(graphs);
+        slot.error = error;
+        slot.ready = true;
+        cv.notify_all();
+    }
+}
+
+bool CircuitBatchLoader::next(std::string &filename,
+                              std::vector<CircuitGraph> &graphs)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    if (delivered == filenames.size())
+        return false;
+    Slot &slot = slots[delivered % capacity];
+    cv.wait(lock, [&] { return slot.ready; });
+
+    filename = filenames[delivered];
+    graphs = std::move(slot.graphs);
+    slot.graphs.clear();
+    std::exception_ptr error = slot.error;
+    slot.error = nullptr;
+    slot.ready = false;
+    delivered++;
+    cv.notify_all(); // the slot can take the next file
+    lock.unlock();
+
+    if (error)
+        std::rethrow_exception(error);
+    return true;
+}
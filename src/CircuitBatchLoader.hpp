@@ -0,0 +1,64 @@
+#ifndef _FHE_CIRCUIT_BATCH_LOADER
+#define _FHE_CIRCUIT_BATCH_LOADER
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+
+// Loads a list of circuit files on a pool of background threads and hands
+// them to the caller in the order of the list, so that the next circuits
+// are opened and parsed while the current one is being solved. At most
+// `capacity` circuits are loaded ahead of the one last returned, which
+// caps the memory held by the queue.
+class CircuitBatchLoader
+{
+public:
+    // what to load from one file, e.g. {CircuitGraph(f)} or cache.load(f)
+    typedef std::function<std::vector<CircuitGraph>(const std::string &)>
+      load_function;
+
+private:
+    struct Slot
+    {
+        std::vector<CircuitGraph> graphs;
+        std::exception_ptr error;
+        bool ready = false;
+    };
+
+    const std::vector<std::string> filenames;
+    const load_function load;
+    const size_t capacity;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Slot> slots; // file i goes to slots[i % capacity]
+    size_t claimed = 0;      // files taken by a worker
+    size_t delivered = 0;    // files returned by next()
+    bool stopped = false;
+    std::vector<std::thread> workers;
+
+    void run();
+
+public:
+    // num_threads = 0 uses all cores; capacity is at least 1
+    CircuitBatchLoader(const std::vector<std::string> &_filenames,
+                       const load_function &_load, const int num_threads = 0,
+                       const int _capacity = 4);
+    ~CircuitBatchLoader();
+    CircuitBatchLoader(const CircuitBatchLoader &) = delete;
+    CircuitBatchLoader &operator=(const CircuitBatchLoader &) = delete;
+
+    // the next file of the list and what was loaded from it; false after
+    // the last one. An exception thrown while loading the file (such as
+    // CircuitFormatError) is thrown here instead; the following files can
+    // still be taken by calling next() again.
+    bool next(std::string &filename, std::vector<CircuitGraph> &graphs);
+};
+
+#endif // _FHE_CIRCUIT_BATCH_LOADER
@@ -0,0 +1,215 @@
+#include "CircuitBuilder.hpp"
+
+#include <cassert>
+
+// errors of the netlist; the reader adds the file name and line
+[[noreturn]] static void fail(const std::string &message)
+{
+    throw CircuitFormatError("", 0, message);
+}
+
+int CircuitBuilder::find(int net)
+{
+    int root = net;
+    while (alias[root] != -1)
+        root = alias[root];
+    while (alias[net] != -1)
+    {
+        int next = alias[net];
+        alias[net] = root;
+        net = next;
+    }
+    return root;
+}
+
+// constants are driven by XOR(x, x) and INV(XOR(x, x)) in build()
+int CircuitBuilder::constant(const bool value)
+{
+    if (const_net[value] == -1)
+        const_net[value] = addNet();
+    return const_net[value];
+}
+
+int CircuitBuilder::addNet()
+{
+    alias.push_back(-1);
+    driver.push_back(-1);
+    is_input.push_back(false);
+    return alias.size() - 1;
+}
+
+void CircuitBuilder::setInput(const int net)
+{
+    if (is_input[net] || driver[net] != -1 || alias[net] != -1)
+        fail("an input is declared twice or driven");
+    is_input[net] = true;
+    inputs.push_back(net);
+}
+
+void CircuitBuilder::setOutput(const int net)
+{
+    outputs.push_back(net);
+}
+
+void CircuitBuilder::addGate(const gate_type type, const int in1,
+                             const int in2, const int out)
+{
+    // every net should have just one driver
+    if (driver[out] != -1 || alias[out] != -1 || is_input[out])
+        fail("a wire is driven twice or is an input");
+    driver[out] = gates.size();
+    gates.push_back(Gate(in1, (type == INV ? -1 : in2), out, type));
+}
+
+void CircuitBuilder::addAlias(const int from, const int out)
+{
+    if (driver[out] != -1 || alias[out] != -1 || is_input[out])
+        fail("a wire is driven twice or is an input");
+    int root = find(from);
+    if (root == out)
+        fail("loop of buffers");
+    alias[out] = root;
+}
+
+void CircuitBuilder::addFunction(const std::vector<int> &ins,
+                                 const std::vector<uint8_t> &truth,
+                                 const int out)
+{
+    int k = ins.size();
+    assert(truth.size() == (1u << k));
+
+    // merge repeated inputs: keep the assignments where copies agree
+    std::vector<int> vars;
+    std::vector<int> var_of(k);
+    for (int j = 0; j < k; j++)
+    {
+        int v = 0;
+        while (v < (int)vars.size() && vars[v] != ins[j])
+            v++;
+        if (v == (int)vars.size())
+            vars.push_back(ins[j]);
+        var_of[j] = v;
+    }
+    int nv = vars.size();
+    std::vector<uint8_t> anf(1u << nv);
+    for (unsigned b = 0; b < anf.size(); b++)
+    {
+        unsigned a = 0;
+        for (int j = 0; j < k; j++)
+            a |= (b >> var_of[j] & 1u) << j;
+        anf[b] = truth[a] & 1;
+    }
+
+    // Moebius transform: truth table -> coefficients of the XOR of monomials
+    for (int j = 0; j < nv; j++)
+        for (unsigned a = 0; a < anf.size(); a++)
+            if (a >> j & 1)
+                anf[a] ^= anf[a ^ (1u << j)];
+
+    int acc = -1;
+    for (unsigned m = 1; m < anf.size(); m++)
+    {
+        if (!anf[m])
+            continue;
+        int term = -1;
+        for (int j = 0; j < nv; j++)
+        {
+            if (!(m >> j & 1))
+                continue;
+            if (term == -1)
+            {
+                term = vars[j];
+                continue;
+            }
+            int t = addNet();
+            addGate(AND, term, vars[j], t);
+            term = t;
+        }
+        if (acc == -1)
+        {
+            acc = term;
+            continue;
+        }
+        int t = addNet();
+        addGate(XOR, acc, term, t);
+        acc = t;
+    }
+
+    if (acc == -1)
+        addAlias(constant(anf[0]), out);
+    else if (anf[0])
+        addGate(INV, acc, -1, out);
+    else
+        addAlias(acc, out);
+}
+
+void CircuitBuilder::build(CircuitGraph &graph)
+{
+    if (const_net[1] != -1)
+        addGate(INV, constant(false), -1, const_net[1]);
+    if (const_net[0] != -1)
+    {
+        if (inputs.empty()) // constants are made from an input
+            fail("constant in a circuit without inputs");
+        addGate(XOR, inputs[0], inputs[0], const_net[0]);
+    }
+
+    // an output must be driven by a gate of its own: copy inputs and nets
+    // that are already an output through two INVs
+    std::vector<bool> claimed(numNets(), false);
+    std::vector<int> out_net(outputs.size());
+    for (int k = 0; k < (int)outputs.size(); k++)
+    {
+        int r = find(outputs[k]);
+        if (is_input[r] || claimed[r])
+        {
+            int t = addNet(), o = addNet();
+            addGate(INV, r, -1, t);
+            addGate(INV, t, -1, o);
+            claimed.resize(numNets(), false);
+            r = o;
+        }
+        if (driver[r] == -1)
+            fail("output " + std::to_string(k) + " is not driven");
+        claimed[r] = true;
+        out_net[k] = r;
+    }
+
+    const int n_input = inputs.size(), n_output = outputs.size();
+    const int n_gate = gates.size(), n_wire = n_input + n_gate;
+
+    // inputs first, outputs last, other gate outputs in creation order
+    std::vector<int> wire(numNets(), -1);
+    for (int i = 0; i < n_input; i++)
+        wire[inputs[i]] = i;
+    for (int k = 0; k < n_output; k++)
+        wire[out_net[k]] = n_wire - n_output + k;
+    int next = n_input;
+    for (int net = 0; net < numNets(); net++)
+    {
+        if (driver[net] != -1 && wire[net] == -1)
+            wire[net] = next++;
+    }
+    assert(next == n_wire - n_output);
+
+    graph.n_gate = n_gate;
+    graph.n_wire = n_wire;
+    graph.n_input = n_input;
+    graph.n_output = n_output;
+    graph.gates.resize(n_gate);
+    graph.wires.assign(n_wire + 1, Wire());
+
+    for (int i = 0; i < n_gate; i++)
+    {
+        const Gate &g = gates[i];
+        int in1 = wire[find(g.in1)];
+        int in2 = (g.type == INV ? n_wire : wire[find(g.in2)]);
+        int out = wire[g.out];
+        if (in1 == -1 || in2 == -1)
+            fail("gate " + std::to_string(i) + " reads a wire never driven");
+        graph.gates[i] = Gate(in1, in2, out, g.type);
+        graph.wires[out].src = i;
+    }
+    graph.buildFanout();
+    graph.buildLevels();
+}
@@ -0,0 +1,54 @@
+#ifndef _FHE_CIRCUIT_BUILDER
+#define _FHE_CIRCUIT_BUILDER
+
+#include <cstdint>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+
+// Incremental construction of a CircuitGraph from gates over "nets".
+// Nets are numbered in creation order and may be used before they are
+// driven. build() renumbers them into wires the way the Bristol format does:
+// inputs first, outputs last, one wire per gate output.
+// Inconsistent netlists (a net driven twice, an undriven output, ...) raise
+// CircuitFormatError without a line.
+class CircuitBuilder
+{
+private:
+    std::vector<int> alias;  // net -> net it copies, or -1
+    std::vector<int> driver; // net -> gate index, or -1
+    std::vector<bool> is_input;
+    std::vector<int> inputs, outputs;
+    std::vector<Gate> gates; // in/out are nets here
+    int const_net[2] = {-1, -1};
+
+    int find(int net);
+    int constant(const bool value);
+
+public:
+    // a new net, not driven yet
+    int addNet();
+    // net is a primary input / output (in declaration order)
+    void setInput(const int net);
+    void setOutput(const int net);
+
+    // out = type(in1, in2); in2 is ignored for INV
+    void addGate(const gate_type type, const int in1, const int in2,
+                 const int out);
+    // out carries the same value as from (a buffer)
+    void addAlias(const int from, const int out);
+    // out = f(ins), where truth[a] is f at the assignment a whose bit j is
+    // the value of ins[j]; lowered into AND/XOR/INV through the algebraic
+    // normal form of f
+    void addFunction(const std::vector<int> &ins,
+                     const std::vector<uint8_t> &truth, const int out);
+
+    int numNets() const
+    {
+        return alias.size();
+    }
+
+    void build(CircuitGraph &graph);
+};
+
+#endif // _FHE_CIRCUIT_BUILDER
@@ -0,0 +1,208 @@
+#include "CircuitCache.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "BinaryFormat.hpp"
+#include "MappedFile.hpp"
+
+uint64_t CircuitCache::hashFile(const std::string &filename)
+{
+    MappedFile file(filename);
+    file.adviseSequential();
+    const char *p = file.begin();
+    const size_t n = file.size();
+
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+    auto mix = [&h](uint64_t w) {
+        w *= 0xff51afd7ed558ccdULL;
+        w ^= w >> 33;
+        h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 29;
+    };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        mix(hostIsLittleEndian() ? w : swapBytes(w));
+    }
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < n; j++)
+        tail |= (uint64_t)(unsigned char)p[i + j] << (8 * j);
+    mix(tail);
+    return h;
+}
+
+void CircuitCache::write(const std::string &filename,
+                         const std::vector<const CircuitGraph *> &graphs,
+                         const uint64_t key)
+{
+    // closed on every path; the explicit fclose reports write errors
+    std::unique_ptr<FILE, int (*)(FILE *)> fp(fopen(filename.c_str(), "wb"),
+                                              fclose);
+    if (!fp)
+        throw std::runtime_error("cannot open " + filename);
+    BinaryOutput out(fp.get());
+
+    out.bytes(MAGIC, sizeof(MAGIC));
+    out.i32(VERSION);
+    out.i32(graphs.size());
+    out.u64(key);
+
+    for (auto g : graphs)
+    {
+        out.i32(g->n_gate);
+        out.i32(g->n_wire);
+        out.i32(g->n_input);
+        out.i32(g->n_output);
+        out.i32(g->wires.size());
+        out.i32(g->fanout.size());
+        out.align();
+
+        for (int i = 0; i < g->n_gate; i++)
+        {
+            const Gate gate = g->gate(i);
+            out.i32(gate.in1);
+            out.i32(gate.in2);
+            out.i32(gate.out);
+            out.i32(gate.type);
+        }
+        out.align();
+        for (auto &w : g->wires)
+            out.i32(w.src);
+        out.align();
+        for (auto b : g->fanout_begin)
+            out.i32(b);
+        out.align();
+        for (auto d : g->fanout)
+            out.i32(d);
+        out.align();
+    }
+
+    if (fclose(fp.release()) != 0)
+        throw std::runtime_error("cannot write " + filename);
+}
+
+bool CircuitCache::isBinary(const char *begin, const char *end)
+{
+    return (size_t)(end - begin) >= sizeof(MAGIC) &&
+           memcmp(begin, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool CircuitCache::read(const std::string &filename,
+                        std::vector<CircuitGraph> &graphs, uint64_t &key)
+{
+    if (access(filename.c_str(), R_OK) != 0)
+        return false;
+    MappedFile file(filename);
+    return read(file.begin(), file.end(), graphs, key);
+}
+
+bool CircuitCache::read(const char *begin, const char *end,
+                        std::vector<CircuitGraph> &graphs, uint64_t &key)
+{
+    BinaryInput in(begin, end);
+
+    int n_graphs;
+    if (!readFileHeader(in, VERSION, n_graphs, key))
+        return false;
+
+    graphs.clear();
+    for (int k = 0; k < n_graphs; k++)
+    {
+        // indices are checked so that a damaged file cannot make
+        // buildLevels read out of bounds
+        BinaryGraph bg;
+        if (!readGraph(in, bg) || checkGraph(bg) != nullptr)
+            return false;
+        const char *gates = bg.gates, *src = bg.src;
+        const char *dest_begin = bg.dest_begin, *dests = bg.dests;
+        const long n_slot = bg.n_slot, n_dest = bg.n_dest;
+
+        CircuitGraph g;
+        g.n_gate = bg.n_gate;
+        g.n_wire = bg.n_wire;
+        g.n_input = bg.n_input;
+        g.n_output = bg.n_output;
+        g.gates.resize(g.n_gate);
+        for (long i = 0; i < g.n_gate; i++)
+            g.gates[i] = Gate(loadInt(gates, 4 * i), loadInt(gates, 4 * i + 1),
+                              loadInt(gates, 4 * i + 2),
+                              (gate_type)loadInt(gates, 4 * i + 3));
+        g.wires.resize(n_slot);
+        g.fanout_begin.resize(n_slot + 1);
+        for (long w = 0; w <= n_slot; w++)
+        {
+            g.fanout_begin[w] = loadInt(dest_begin, w);
+            if (w < n_slot)
+                g.wires[w].src = loadInt(src, w);
+        }
+        g.fanout.resize(n_dest);
+        if (hostIsLittleEndian())
+            memcpy(g.fanout.data(), dests, 4L * n_dest);
+        else
+            for (long j = 0; j < n_dest; j++)
+                g.fanout[j] = loadInt(dests, j);
+        try
+        {
+            g.buildLevels();
+        }
+        catch (const CircuitFormatError &) // gates in a cycle
+        {
+            return false;
+        }
+        graphs.push_back(std::move(g));
+    }
+    return true;
+}
+
+std::vector<CircuitGraph>
+CircuitCache::load(const std::string &filename, const bool bootstrap) const
+{
+    auto reduce = [bootstrap](const CircuitGraph &g) {
+        return bootstrap ? g.reduceBootstrap() : g.reduceSize();
+    };
+    std::vector<CircuitGraph> graphs;
+    if (dir.empty()) // caching disabled
+    {
+        graphs.push_back(CircuitGraph(filename));
+        graphs.push_back(reduce(graphs[0]));
+        return graphs;
+    }
+
+    const uint64_t key = hashFile(filename);
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx%s.fcg", (unsigned long long)key,
+             bootstrap ? ".boot" : "");
+    const std::string path = dir + name;
+
+    uint64_t stored_key;
+    if (read(path, graphs, stored_key) && stored_key == key &&
+        graphs.size() == 2)
+        return graphs;
+
+    CircuitGraph graph(filename);
+    CircuitGraph reduced = reduce(graph);
+
+    // several jobs (or threads of a CircuitBatchLoader) may fill the same
+    // entry: write aside, then rename
+    mkdir(dir.c_str(), 0755);
+    const std::string tmp =
+      path + ".tmp" + std::to_string(getpid()) + "-" +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    write(tmp, {&graph, &reduced}, key);
+    rename(tmp.c_str(), path.c_str());
+
+    graphs.clear();
+    graphs.push_back(std::move(graph));
+    graphs.push_back(std::move(reduced));
+    return graphs;
+}
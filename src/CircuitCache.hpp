@@ -0,0 +1,64 @@
+#ifndef _FHE_CIRCUIT_CACHE
+#define _FHE_CIRCUIT_CACHE
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+
+/*
+  === Binary Circuit Format ===
+  A file holds one or more graphs as fixed-width little-endian arrays, each
+  array starting at a multiple of 8 bytes, so that it can be used straight
+  from a memory mapping:
+
+    file header   : magic "FHECGRPH", u32 version, u32 n_graphs, u64 key
+    graph header  : i32 n_gate, n_wire, n_input, n_output,
+                    i32 n_slot (= wires.size()), i32 n_dest
+    i32 gates[4 * n_gate]   (in1, in2, out, type)
+    i32 src[n_slot]
+    i32 dest_begin[n_slot + 1]
+    i32 dests[n_dest]       (fan-outs of wire w are
+                             dests[dest_begin[w] .. dest_begin[w + 1]),
+                             i.e. CircuitGraph::fanout_begin and fanout)
+
+  key identifies what the file was made from (e.g. the hash of the source
+  circuit); the version changes whenever the layout or the graphs stored
+  for a key (such as the result of reduceSize) change.
+*/
+class CircuitCache
+{
+private:
+    std::string dir;
+
+public:
+    static const uint32_t VERSION = 2;
+
+    CircuitCache(const std::string &cache_dir) : dir(cache_dir){};
+
+    // 64-bit (non-cryptographic) hash of the content of a file
+    static uint64_t hashFile(const std::string &filename);
+
+    static void write(const std::string &filename,
+                      const std::vector<const CircuitGraph *> &graphs,
+                      const uint64_t key = 0);
+    // returns false if the file is not a binary circuit of this version or
+    // is truncated or damaged; key is set to the key stored in the file
+    static bool read(const std::string &filename,
+                     std::vector<CircuitGraph> &graphs, uint64_t &key);
+    // the same from the bytes [begin, end) of a binary circuit
+    static bool read(const char *begin, const char *end,
+                     std::vector<CircuitGraph> &graphs, uint64_t &key);
+    // whether the bytes [begin, end) start like a binary circuit
+    static bool isBinary(const char *begin, const char *end);
+
+    // the circuit and graph.reduceSize() (graph.reduceBootstrap() if
+    // bootstrap, kept in an entry of its own), parsed and reduced only if
+    // the cache has no entry for the content of the file yet (always if the
+    // cache directory is empty). Safe to call from several threads.
+    std::vector<CircuitGraph> load(const std::string &filename,
+                                   const bool bootstrap = false) const;
+};
+
+#endif // _FHE_CIRCUIT_CACHE
@@ -0,0 +1,189 @@
+#include "CircuitDecomposition.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+// root of the set of x, halving the path on the way
+static int findRoot(std::vector<int32_t> &parent, int x)
+{
+    while (parent[x] != x)
+    {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+CircuitDecomposition::CircuitDecomposition(const CircuitGraph &graph,
+                                           const int min_gates)
+{
+    const int n_gate = graph.n_gate;
+
+    // union-find over the gates, by size
+    std::vector<int32_t> parent(n_gate), size(n_gate, 1);
+    std::iota(parent.begin(), parent.end(), 0);
+    for (int w = graph.n_input; w < graph.n_wire; w++)
+    {
+        const int s = graph.src(w);
+        if (s == -1)
+            continue;
+        for (const int d : graph.dests(w))
+        {
+            int a = findRoot(parent, s), b = findRoot(parent, d);
+            if (a == b)
+                continue;
+            if (size[a] < size[b])
+                std::swap(a, b);
+            parent[b] = a;
+            size[a] += size[b];
+        }
+    }
+
+    // components by decreasing size (then first gate); the small ones are
+    // put together until a part has min_gates gates
+    std::vector<int32_t> roots;
+    for (int i = 0; i < n_gate; i++)
+        if (findRoot(parent, i) == i)
+            roots.push_back(i);
+    n_components = roots.size();
+    std::stable_sort(roots.begin(), roots.end(),
+                     [&](const int a, const int b)
+                     { return size[a] > size[b]; });
+    std::vector<int32_t> part_of(n_gate, -1); // of the roots first
+    std::vector<long> part_size;
+    int open = -1; // part taking small components
+    for (const int r : roots)
+    {
+        if (size[r] >= min_gates)
+        {
+            part_of[r] = part_size.size();
+            part_size.push_back(size[r]);
+            continue;
+        }
+        if (open == -1)
+        {
+            open = part_size.size();
+            part_size.push_back(0);
+        }
+        part_of[r] = open;
+        part_size[open] += size[r];
+        if (part_size[open] >= min_gates)
+            open = -1;
+    }
+
+    // parts by decreasing size, the gates of each in increasing order
+    std::vector<int32_t> order(part_size.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](const int a, const int b)
+                     { return part_size[a] > part_size[b]; });
+    std::vector<int32_t> rank(order.size());
+    for (size_t k = 0; k < order.size(); k++)
+        rank[order[k]] = k;
+    for (const int r : roots)
+        part_of[r] = rank[part_of[r]];
+    gates_of.resize(order.size());
+    for (int i = 0; i < n_gate; i++)
+    {
+        part_of[i] = part_of[findRoot(parent, i)];
+        gates_of[part_of[i]].push_back(i);
+    }
+    std::vector<int32_t>().swap(parent);
+    std::vector<int32_t>().swap(size);
+
+    // index of each gate in its part, and of each wire (scratch, reset for
+    // the input wires after each part)
+    std::vector<int32_t> local(n_gate), wire_new(graph.n_wire, -1);
+    for (const auto &gates : gates_of)
+        for (size_t k = 0; k < gates.size(); k++)
+            local[gates[k]] = k;
+    parts.reserve(gates_of.size());
+    for (size_t p = 0; p < gates_of.size(); p++)
+        parts.push_back(extract(graph, gates_of[p], part_of, local, wire_new,
+                                p));
+}
+
+CircuitGraph CircuitDecomposition::extract(
+  const CircuitGraph &graph, const std::vector<int32_t> &gates,
+  const std::vector<int32_t> &part_of, const std::vector<int32_t> &local,
+  std::vector<int32_t> &wire_new, const int p)
+{
+    // a loaded circuit has the sentinel wire read by INV gates
+    const bool loaded = (graph.wires.size() == (size_t)graph.n_wire + 1);
+    const int first_output = graph.n_wire - graph.n_output;
+
+    // wires of the part: inputs it reads, then the outputs of its gates
+    // that are not outputs of the circuit, then those that are
+    // (a wire without source is an input: reduceSize moves an input wire
+    // that is also an output to the outputs)
+    std::vector<int32_t> inputs, general, outputs;
+    auto isInput = [&](const int w)
+    { return w < graph.n_input || graph.src(w) == -1; };
+    auto addInput = [&](const int w)
+    {
+        if (isInput(w) && wire_new[w] == -1)
+        {
+            wire_new[w] = 0;
+            inputs.push_back(w);
+        }
+    };
+    for (const int i : gates)
+    {
+        const Gate g = graph.gate(i);
+        addInput(g.in1);
+        if (g.type != INV)
+            addInput(g.in2);
+        if (isInput(g.out))
+            addInput(g.out); // a vertex of reduceSize for an input wire
+        else if (g.out < first_output)
+            general.push_back(g.out);
+        else
+            outputs.push_back(g.out);
+    }
+    std::sort(inputs.begin(), inputs.end());
+    std::sort(general.begin(), general.end());
+    std::sort(outputs.begin(), outputs.end());
+
+    std::vector<int32_t> old_wire(inputs);
+    old_wire.insert(old_wire.end(), general.begin(), general.end());
+    old_wire.insert(old_wire.end(), outputs.begin(), outputs.end());
+    const int n_wire = old_wire.size();
+    for (int w = 0; w < n_wire; w++)
+        wire_new[old_wire[w]] = w;
+
+    std::vector<Gate> ng(gates.size());
+    std::vector<Wire> nw(n_wire + (loaded ? 1 : 0));
+    for (size_t k = 0; k < gates.size(); k++)
+    {
+        Gate g = graph.gate(gates[k]);
+        g.in1 = wire_new[g.in1];
+        if (g.type != INV)
+            g.in2 = wire_new[g.in2];
+        else if (loaded)
+            g.in2 = n_wire;
+        g.out = wire_new[g.out];
+        if (g.out >= (int)inputs.size())
+            nw[g.out].src = k;
+        ng[k] = g;
+    }
+
+    CircuitGraph part(ng, nw, inputs.size(), outputs.size());
+    part.n_wire = n_wire;
+
+    // fan-outs within the part, in the order of the gates
+    part.fanout_begin.assign(nw.size() + 1, 0);
+    for (int w = 0; w < n_wire; w++)
+    {
+        for (const int d : graph.dests(old_wire[w]))
+            if (part_of[d] == p)
+                part.fanout.push_back(local[d]);
+        part.fanout_begin[w + 1] = part.fanout.size();
+    }
+    if (loaded)
+        part.fanout_begin[n_wire + 1] = part.fanout.size();
+    part.buildLevels();
+
+    for (const int w : inputs)
+        wire_new[w] = -1;
+    return part;
+}
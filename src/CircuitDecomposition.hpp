@@ -0,0 +1,79 @@
+#ifndef _FHE_CIRCUIT_DECOMPOSITION
+#define _FHE_CIRCUIT_DECOMPOSITION
+
+#include <cstdint>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+#include "Parallel.hpp"
+
+// Splits a circuit (as loaded, or reduced) into the weakly connected
+// components of its gates, for solving them one by one, e.g. the output
+// cones of a bit-sliced circuit or the S-boxes of a round. Two gates are
+// connected when one reads the output of the other; input wires do not
+// connect the gates that read them, since every solver takes an input as a
+// constant (level 0, size 2). The objectives of the bootstrap and
+// relinearize problems (any solver) are then the sums over the components.
+//
+// Components smaller than min_gates are grouped into one part until the
+// part has min_gates gates, so that tiny cones do not cost a model each.
+// A part is a graph of the same form as the circuit: its inputs, then its
+// other wires, then its outputs, each in their original order, and its
+// gates in their original order. Parts are sorted by decreasing size.
+class CircuitDecomposition
+{
+private:
+    std::vector<CircuitGraph> parts;
+    std::vector<std::vector<int32_t>> gates_of;
+    int n_components = 0;
+
+    // part p, made of gates; local is the index of a gate in its part, and
+    // wire_new a scratch array of -1 for the input wires
+    static CircuitGraph extract(const CircuitGraph &graph,
+                                const std::vector<int32_t> &gates,
+                                const std::vector<int32_t> &part_of,
+                                const std::vector<int32_t> &local,
+                                std::vector<int32_t> &wire_new, const int p);
+
+public:
+    explicit CircuitDecomposition(const CircuitGraph &graph,
+                                  const int min_gates = 1024);
+
+    // number of weakly connected components / of parts
+    int components() const
+    {
+        return n_components;
+    }
+    int size() const
+    {
+        return parts.size();
+    }
+    const CircuitGraph &part(const int p) const
+    {
+        return parts[p];
+    }
+    // the original gate of each gate of part p
+    const std::vector<int32_t> &gatesOf(const int p) const
+    {
+        return gates_of[p];
+    }
+
+    // sum over the parts of fn(thread_id, part), the objective of a part,
+    // on max_threads threads (0: all cores) taking the parts largest first.
+    // A thread solves one part at a time, so fn can use a solver of its
+    // own per thread_id.
+    template <class F>
+    long solveParts(const int max_threads, F fn) const
+    {
+        std::vector<long> objective(parts.size());
+        parallelTasks(resolveThreads(max_threads), parts.size(),
+                      [&](const int t, const long p)
+                      { objective[p] = fn(t, parts[p]); });
+        long sum = 0;
+        for (const long o : objective)
+            sum += o;
+        return sum;
+    }
+};
+
+#endif // _FHE_CIRCUIT_DECOMPOSITION
@@ -1,20 +1,53 @@
 #include "CircuitGraph.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
-#include <map>
-#include <queue>
-#include <set>
 #include <vector>
 
-// TODO read blif format
-CircuitGraph::CircuitGraph(const std::string &filename)
+#include "CircuitReader.hpp"
+#include "ExternalGraph.hpp"
+#include "Parallel.hpp"
+#include "ReductionMap.hpp"
+
+CircuitGraph::CircuitGraph(const std::string &filename, const load_mode mode,
+                           const int max_threads)
+{
+    if (mode == LOAD_STREAM)
+        readStream(filename);
+    else
+        CircuitReader::read(filename, *this, mode, max_threads);
+}
+
+// line of the position of ifs (counted again from the start of the file)
+static long streamLine(const std::string &filename, std::ifstream &ifs)
+{
+    ifs.clear();
+    const long pos = ifs.tellg();
+    std::ifstream again(filename);
+    long line = 1;
+    for (long i = 0; i < pos && again; i++)
+        line += (again.get() == '\n');
+    return line;
+}
+
+void CircuitGraph::readStream(const std::string &filename)
 {
     std::ifstream ifs(filename);
+    if (!ifs)
+        throw std::runtime_error("cannot open " + filename);
+    auto fail = [&](const std::string &message) {
+        throw CircuitFormatError(filename, streamLine(filename, ifs), message);
+    };
+
     int n1, n2;
     ifs >> n_gate >> n_wire >> n1 >> n2 >> n_output;
-    n_input = n1 + n2;
-    assert(n_gate + n_input == n_wire);
+    // added in long: the counts are checked before they are used
+    const long inputs = (long)n1 + n2;
+    if (!ifs || n_gate < 0 || n1 < 0 || n2 < 0 || n_output < 0 ||
+        n_gate + inputs != n_wire || n_output > n_wire - inputs)
+        fail("inconsistent header (n_gate + n_input != n_wire)");
+    n_input = inputs;
 
     gates.resize(n_gate);
     wires.resize(n_wire + 1);
@@ -23,7 +56,10 @@ CircuitGraph::CircuitGraph(const std::string &filename)
     {
         int n_in, n_out;
         ifs >> n_in >> n_out;
-        assert((n_in == 1 || n_in == 2) && n_out == 1);
+        if (!ifs)
+            fail(ifs.eof() ? "unexpected end of file" : "expected an integer");
+        if ((n_in != 1 && n_in != 2) || n_out != 1)
+            fail("a gate has 1 or 2 inputs and 1 output");
 
         int in1, in2 = -1, out;
         std::string type;
@@ -31,150 +67,476 @@ CircuitGraph::CircuitGraph(const std::string &filename)
         if (n_in == 2)
             ifs >> in2;
         ifs >> out >> type;
+        if (!ifs)
+            fail(ifs.eof() ? "unexpected end of file" : "expected an integer");
 
-        assert(0 <= in1 && in1 <= n_wire);
-        assert(0 <= out && out <= n_wire);
-        if (n_in == 2)
-            assert(0 <= in2 && in2 <= n_wire);
+        const unsigned nw = n_wire;
+        if ((unsigned)in1 >= nw || (unsigned)out >= nw ||
+            (n_in == 2 && (unsigned)in2 >= nw))
+            fail("wire out of range [0, " + std::to_string(n_wire) + ")");
 
-        if (type == "AND")
-        {
-            assert(n_in == 2 && n_out == 1);
-            gates[i] = Gate(in1, in2, out, AND);
-        }
-        else if (type == "XOR")
+        if (type == "AND" || type == "XOR")
         {
-            assert(n_in == 2 && n_out == 1);
-            gates[i] = Gate(in1, in2, out, XOR);
+            if (n_in != 2)
+                fail("AND/XOR has 2 inputs");
+            gates[i] = Gate(in1, in2, out, type == "AND" ? AND : XOR);
         }
         else if (type == "INV")
         {
-            assert(n_in == 1 && n_out == 1);
+            if (n_in != 1)
+                fail("INV has 1 input");
             gates[i] = Gate(in1, n_wire, out, INV);
         }
         else
         { // Unknown gate type
-            assert(false);
+            fail("unknown gate type '" + type + "'");
         }
 
-        if (in1 >= 0)
-            wires[in1].dests.push_back(i);
-        if (in2 >= 0)
-            wires[in2].dests.push_back(i);
-
         // every wire should have just one input (or no, for inwire)
-        assert(wires[out].src == -1);
+        if (wires[out].src != -1 || out < n_input)
+            fail("wire " + std::to_string(out) +
+                 (out < n_input ? " is an input" : " is driven twice"));
         wires[out].src = i;
     }
+    std::string rest;
+    if (ifs >> rest)
+        fail("more gates than the header says");
+    buildFanout();
+    buildLevels();
+}
+
+void CircuitGraph::buildFanout()
+{
+    fanout_begin.assign(wires.size() + 1, 0);
+    for (int i = 0; i < n_gate; i++)
+    {
+        const Gate g = gate(i);
+        fanout_begin[g.in1 + 1]++;
+        if (g.type != INV)
+            fanout_begin[g.in2 + 1]++;
+    }
+    for (size_t w = 0; w < wires.size(); w++)
+        fanout_begin[w + 1] += fanout_begin[w];
+
+    // fill from the front of each run; fanout_begin[w] ends up at the end of
+    // run w, i.e. the old fanout_begin[w + 1], and is shifted back below
+    fanout.resize(fanout_begin.back());
+    for (int i = 0; i < n_gate; i++)
+    {
+        const Gate g = gate(i);
+        fanout[fanout_begin[g.in1]++] = i;
+        if (g.type != INV)
+            fanout[fanout_begin[g.in2]++] = i;
+    }
+    for (size_t w = wires.size(); w > 0; w--)
+        fanout_begin[w] = fanout_begin[w - 1];
+    fanout_begin[0] = 0;
+}
+
+void CircuitGraph::buildLevels()
+{
+    // gates reading gate i are the fan-outs of its output wire, as long as
+    // i is the source of that wire (not so for the gates that reduceSize
+    // makes for input wires)
+    auto pred = [&](const int w) { return w < 0 ? -1 : wires[w].src; };
+
+    topo_order.resize(n_gate);
+    bool sorted = true;
+    for (int i = 0; i < n_gate && sorted; i++)
+    {
+        const Gate g = gate(i);
+        sorted = pred(g.in1) < i && (g.type == INV || pred(g.in2) < i);
+        topo_order[i] = i;
+    }
+    if (!sorted)
+    {
+        // Kahn's algorithm; topo_order doubles as the FIFO queue
+        std::vector<int32_t> indeg(n_gate, 0);
+        for (int i = 0; i < n_gate; i++)
+        {
+            const Gate g = gate(i);
+            indeg[i] = (pred(g.in1) >= 0) +
+                       (g.type != INV && pred(g.in2) >= 0);
+        }
+        int tail = 0;
+        for (int i = 0; i < n_gate; i++)
+            if (indeg[i] == 0)
+                topo_order[tail++] = i;
+        for (int head = 0; head < tail; head++)
+        {
+            const int i = topo_order[head];
+            const int w = gate(i).out;
+            if (wires[w].src != i)
+                continue;
+            for (const int d : dests(w))
+                if (--indeg[d] == 0)
+                    topo_order[tail++] = d;
+        }
+        if (tail != n_gate)
+            throw CircuitFormatError("", 0,
+                                     "the gates form a cycle (" +
+                                       std::to_string(n_gate - tail) +
+                                       " gates cannot be ordered)");
+    }
+
+    and_depth.assign(n_gate, 0);
+    xor_depth.assign(n_gate, 0);
+    for (const int i : topo_order)
+    {
+        const Gate g = gate(i);
+        int a = 0, x = 0;
+        for (const int w : {g.in1, g.type == INV ? -1 : g.in2})
+        {
+            const int p = pred(w);
+            if (p >= 0)
+            {
+                a = std::max(a, and_depth[p]);
+                x = std::max(x, xor_depth[p]);
+            }
+        }
+        and_depth[i] = a + (g.type == AND);
+        xor_depth[i] = x + (g.type == XOR);
+    }
+}
+
+int CircuitGraph::andDepth() const
+{
+    int depth = 0;
+    for (const int d : and_depth)
+        depth = std::max(depth, d);
+    return depth;
+}
+
+bool CircuitGraph::inTopologicalOrder() const
+{
+    for (int i = 0; i < (int)topo_order.size(); i++)
+        if (topo_order[i] != i)
+            return false;
+    return true;
+}
+
+size_t CircuitGraph::memoryBytes() const
+{
+    return gates.capacity() * sizeof(Gate) + packed.memoryBytes() +
+           wires.capacity() * sizeof(Wire) +
+           (fanout_begin.capacity() + fanout.capacity() +
+            topo_order.capacity() + and_depth.capacity() +
+            xor_depth.capacity()) *
+             sizeof(int32_t);
+}
+
+bool CircuitGraph::sameGates(const CircuitGraph &g) const
+{
+    if (!packed_mode && !g.packed_mode)
+        return gates == g.gates;
+    if (n_gate != g.n_gate)
+        return false;
+    for (int i = 0; i < n_gate; i++)
+        if (!(gate(i) == g.gate(i)))
+            return false;
+    return true;
+}
+
+void CircuitGraph::packGates()
+{
+    if (packed_mode)
+        return;
+    packed = PackedGates(gates);
+    std::vector<Gate>().swap(gates);
+    packed_mode = true;
+}
 
+void CircuitGraph::unpackGates()
+{
+    if (!packed_mode)
+        return;
+    gates = packed.unpack();
+    packed = PackedGates();
+    packed_mode = false;
+}
+
+PackedGates::PackedGates(const std::vector<Gate> &gates)
+  : in1_(gates.size()),
+    in2_(gates.size()),
+    out_(gates.size()),
+    types((gates.size() + PER_WORD - 1) / PER_WORD, 0)
+{
+    size_t count[3] = {0, 0, 0};
+    for (auto &g : gates)
+    {
+        assert(g.type == XOR || g.type == AND || g.type == INV);
+        count[g.type]++;
+    }
+    for (int t = 0; t < 3; t++)
+        of_type[t].reserve(count[t]);
+
+    for (size_t i = 0; i < gates.size(); i++)
+    {
+        const Gate &g = gates[i];
+        in1_[i] = g.in1;
+        in2_[i] = g.in2;
+        out_[i] = g.out;
+        types[i / PER_WORD] |= (uint64_t)g.type << (TYPE_BITS * (i % PER_WORD));
+        of_type[g.type].push_back(i);
+    }
+}
+
+std::vector<Gate> PackedGates::unpack() const
+{
+    std::vector<Gate> gates(size());
+    for (size_t i = 0; i < gates.size(); i++)
+        gates[i] = gate(i);
+    return gates;
+}
+
+size_t PackedGates::memoryBytes() const
+{
+    size_t bytes = (in1_.capacity() + in2_.capacity() + out_.capacity()) *
+                     sizeof(int32_t) +
+                   types.capacity() * sizeof(uint64_t);
+    for (int t = 0; t < 3; t++)
+        bytes += of_type[t].capacity() * sizeof(int32_t);
+    return bytes;
+}
+
+CircuitGraph CircuitGraph::reduceSize(const int max_threads) const
+{
+    return reduceSize(*this, max_threads);
+}
+
+CircuitGraph CircuitGraph::reduceSize(ReductionMap &map,
+                                      const int max_threads) const
+{
+    return reduceSize(*this, map, max_threads);
+}
+
+/*
+  Why reduceBootstrap keeps the optimum of the bootstrap problem.
+
+  Inputs are at level 0, and so is a XOR / INV gate of level-0 values unless
+  it is bootstrapped; a bootstrap only sets a level to L - N >= 0, so an
+  optimal solution bootstraps none of these gates ("zero" wires below). Then
+  XOR(a, z) with z zero has the level of a, as INV(a) has, and reduceSize
+  merging INV(a) into a keeps the optimum: bootstrapping INV(a) instead of a
+  either changes nothing (a is bootstrapped or below L - N) or can be moved
+  to a, which lowers the other readers of a. AND(a, z) gets one level more
+  than a, as AND(a, a) does. XOR(z, z') is zero itself, INV(z) for the
+  model, and is merged into the vertex of an input; a zero output becomes
+  that input wire, as reduceSize does with an INV chain of an input.
+*/
+CircuitGraph CircuitGraph::bootstrapLevels() const
+{
+    if (wires.size() != (size_t)n_wire + 1)
+        throw std::invalid_argument(
+          "reduceBootstrap takes a circuit as loaded, not a reduced graph");
+
+    std::vector<char> zero(n_wire + 1, 0);
     for (int i = 0; i < n_input; i++)
-        assert(wires[i].src == -1);
+        zero[i] = 1;
+    std::vector<Gate> ng(n_gate);
+    for (const int i : topo_order)
+    {
+        Gate g = gate(i);
+        if (g.type != INV && (zero[g.in1] || zero[g.in2]))
+        {
+            // the operand that decides the level first
+            if (zero[g.in1])
+                std::swap(g.in1, g.in2);
+            if (g.type == XOR)
+            {
+                g.type = INV;
+                g.in2 = n_wire;
+            }
+            else
+            {
+                g.in2 = g.in1;
+            }
+        }
+        zero[g.out] = (g.type == INV && zero[g.in1]);
+        ng[i] = g;
+    }
+
+    CircuitGraph levels(ng, wires, n_input, n_output);
+    levels.n_wire = n_wire; // wires has the sentinel
+    levels.buildFanout();
+    levels.buildLevels();
+    return levels;
+}
+
+CircuitGraph CircuitGraph::reduceBootstrap(const int max_threads) const
+{
+    return reduceSize(bootstrapLevels(), max_threads);
+}
+
+CircuitGraph CircuitGraph::reduceBootstrap(ReductionMap &map,
+                                           const int max_threads) const
+{
+    return reduceSize(bootstrapLevels(), map, max_threads);
+}
+
+template <class Graph>
+CircuitGraph CircuitGraph::reduceSize(const Graph &graph,
+                                      const int max_threads)
+{
+    const int num_threads = resolveThreads(max_threads);
+    if (num_threads > 1)
+        return reduceSizeParallel(graph, num_threads, nullptr);
+    return reduceSizeSequential(graph, nullptr);
+}
+
+template <class Graph>
+CircuitGraph CircuitGraph::reduceSize(const Graph &graph, ReductionMap &map,
+                                      const int max_threads)
+{
+    const int num_threads = resolveThreads(max_threads);
+    if (num_threads > 1)
+        return reduceSizeParallel(graph, num_threads, &map);
+    return reduceSizeSequential(graph, &map);
 }
 
-CircuitGraph CircuitGraph::reduceSize()
+template <class Graph>
+CircuitGraph CircuitGraph::reduceSizeSequential(const Graph &graph,
+                                                ReductionMap *map)
 {
+    const int n_gate = graph.n_gate, n_wire = graph.n_wire;
+    const int n_input = graph.n_input, n_output = graph.n_output;
+
     std::vector<int> num_v(n_gate, -1), num_e(n_wire, -1);
     int usedIds = 0;
-    std::vector<int> num2v(n_wire, -1); // from new idx to old idx
 
-    std::queue<int> que; // queue of edge index
+    // FIFO queue of edge (wire) indices; a wire is queued at most twice
+    std::vector<int> que;
+    que.reserve(n_input + n_gate);
     for (int i = 0; i < n_input; i++)
     {
-        que.push(i);
+        que.push_back(i);
         num_e[i] = usedIds++;
     }
     for (int i = 0; i < n_gate; i++)
     {
-        if (gates[i].type == AND)
+        const Gate g = graph.gate(i);
+        if (g.type == AND)
         {
-            que.push(gates[i].out);
+            que.push_back(g.out);
             num_v[i] = usedIds++;
-            num2v[num_v[i]] = i;
-            num_e[gates[i].out] = num_v[i];
+            num_e[g.out] = num_v[i];
         }
     }
 
-    while (!que.empty())
+    for (size_t head = 0; head < que.size(); head++)
     {
-        int i = que.front();
-        que.pop(); // edge(wire) index
-        for (auto &gi : wires[i].dests)
+        const int i = que[head]; // edge(wire) index
+        for (const int gi : graph.dests(i))
         {
-            if (gates[gi].type == AND)
+            const Gate g = graph.gate(gi);
+            if (g.type == AND)
                 continue;
             bool toNext = false;
             if (num_v[gi] == -1)
             {
                 // first visit of the node
                 num_v[gi] = num_e[i];
-                if (gates[gi].type == INV)
+                if (g.type == INV)
                     toNext = true;
             }
             else
             {
                 // second visit of the node
                 if (num_v[gi] != num_e[i])
-                {
                     num_v[gi] = usedIds++;
-                    num2v[num_v[gi]] = gi;
-                }
                 toNext = true;
             }
             if (toNext)
             {
-                num_e[gates[gi].out] = num_v[gi];
-                que.push(gates[gi].out);
+                num_e[g.out] = num_v[gi];
+                que.push_back(g.out);
             }
         }
     }
+    std::vector<int>().swap(que);
+
+    // every gate and wire is reached from the inputs and the AND gates,
+    // unless the gates form a cycle, which only an ExternalGraph can hold
+    // (checkGraph leaves cycles to its readers), or the graph is already
+    // reduced and has the vertex of an input, which no wire leads to
+    for (int i = 0; i < n_gate; i++)
+        if (num_v[i] == -1)
+            throw CircuitFormatError("", 0, "gate " + std::to_string(i) +
+                                              " is not reached");
+    for (int i = 0; i < n_wire; i++)
+        if (num_e[i] == -1)
+            throw CircuitFormatError("", 0, "wire " + std::to_string(i) +
+                                              " is not reached");
 
-    // edge_index -> num_v
-    std::map<int, int> input_vertices;
+    // input wire -> new index of the gate that stands for it, or -1
+    std::vector<int> input_vertices(n_input, -1);
 
     std::vector<Gate> ng;
     std::vector<Wire> nw;
 
     // input wires : the same as original
     // output wires : build below
-    std::set<int> out_wires, general_wires;
+    int n_out_wires;
     {
-        // re-numbering wires and gates
-        std::map<int, int> nume2new_idx, numv2new_idx;
+        // re-numbering wires and gates. Ids (num_e, num_v) are dense in
+        // [0, usedIds), so marks indexed by id take the place of ordered
+        // sets: new wires are the inputs, then the other ids that are the
+        // id of a general wire, then the ids of output wires, each group in
+        // increasing order of id. An output with the id of an input (an
+        // INV chain of it, at level 0) is that input wire: it gets no
+        // output wire, which would take the input out of the input range
+        enum : char
+        {
+            ID_NONE,
+            ID_GENERAL,
+            ID_OUT
+        };
+        std::vector<char> kind(usedIds, ID_NONE);
         for (int i = n_wire - n_output; i < n_wire; i++)
         {
-            out_wires.insert(num_e[i]);
+            if (num_e[i] >= n_input)
+                kind[num_e[i]] = ID_OUT;
         }
         for (int i = n_input; i < n_wire - n_output; i++)
         {
-            if (num_e[i] >= n_input &&
-                out_wires.find(num_e[i]) == out_wires.end())
-                general_wires.insert(num_e[i]);
+            if (num_e[i] >= n_input && kind[num_e[i]] == ID_NONE)
+                kind[num_e[i]] = ID_GENERAL;
         }
 
-        int cnt = 0;
+        std::vector<int> nume2new_idx(usedIds, -1);
         for (int i = 0; i < n_input; i++)
-            nume2new_idx[i] = cnt++;
-        for (auto i : general_wires)
-            nume2new_idx[i] = cnt++;
-        for (auto i : out_wires)
-            nume2new_idx[i] = cnt++;
+            nume2new_idx[i] = i;
+        int cnt = n_input;
+        for (int id = 0; id < usedIds; id++)
+            if (kind[id] == ID_GENERAL)
+                nume2new_idx[id] = cnt++;
+        n_out_wires = 0;
+        for (int id = 0; id < usedIds; id++)
+            if (kind[id] == ID_OUT)
+            {
+                nume2new_idx[id] = cnt++;
+                n_out_wires++;
+            }
         nw.resize(cnt);
 
+        // gates are numbered in the order their ids first appear
+        std::vector<int> numv2new_idx(usedIds, -1);
         cnt = 0;
         for (int i = 0; i < n_gate; i++)
         {
-            if (numv2new_idx.find(num_v[i]) == numv2new_idx.end())
+            if (numv2new_idx[num_v[i]] == -1)
                 numv2new_idx[num_v[i]] = cnt++;
         }
         ng.resize(cnt);
 
         for (int i = 0; i < n_gate; i++)
         {
-            if ((gates[i].type == XOR && gates[i].in1 == gates[i].in2 &&
-                 gates[i].in1 != -1 && num_e[gates[i].in1] < n_input) ||
-                (gates[i].type == INV && num_e[gates[i].in1] < n_input))
+            const Gate g = graph.gate(i);
+            if ((g.type == XOR && g.in1 == g.in2 && g.in1 != -1 &&
+                 num_e[g.in1] < n_input) ||
+                (g.type == INV && num_e[g.in1] < n_input))
             {
-                input_vertices[num_e[gates[i].in1]] = numv2new_idx[num_v[i]];
+                input_vertices[num_e[g.in1]] = numv2new_idx[num_v[i]];
             }
         }
 
@@ -184,18 +546,21 @@ CircuitGraph CircuitGraph::reduceSize()
             num_v[i] = numv2new_idx[num_v[i]];
     }
 
-    // trick to treat input-edge as a vertex
+    // trick to treat input-edge as a vertex: input wires get a pseudo
+    // source gate (kept here, the graph itself is not modified)
+    std::vector<int> input_src(n_input);
+    auto src = [&](int w) { return w < n_input ? input_src[w] : graph.src(w); };
     int trick_add_ng_cnt = 0;
     for (int i = 0; i < n_input; i++)
     {
-        if (input_vertices.find(i) != input_vertices.end())
+        if (input_vertices[i] != -1)
         {
-            wires[i].src = num_v.size();
+            input_src[i] = num_v.size();
             num_v.push_back(input_vertices[i]);
         }
         else
         {
-            wires[i].src = num_v.size();
+            input_src[i] = num_v.size();
             num_v.push_back(ng.size());
             ng.push_back(Gate(-1, -1, i, INV));
             trick_add_ng_cnt++;
@@ -216,34 +581,38 @@ CircuitGraph CircuitGraph::reduceSize()
         }
     };
 
+    // fan-out edges (new wire, new gate) in the order they are found
+    std::vector<int32_t> edge_wire, edge_gate;
     for (int i = 0; i < n_wire; i++)
     {
-        assert(ng[num_v[wires[i].src]].out == -1 ||
-               ng[num_v[wires[i].src]].out == num_e[i]);
-        ng[num_v[wires[i].src]].out = num_e[i];
-        assert(nw[num_e[i]].src == -1 ||
-               nw[num_e[i]].src == num_v[wires[i].src]);
-        nw[num_e[i]].src = num_v[wires[i].src];
-
-        for (auto to : wires[i].dests)
+        const int v = num_v[src(i)];
+        assert(ng[v].out == -1 || ng[v].out == num_e[i]);
+        ng[v].out = num_e[i];
+        assert(nw[num_e[i]].src == -1 || nw[num_e[i]].src == v);
+        nw[num_e[i]].src = v;
+
+        for (const int to : graph.dests(i))
         {
-            if (num_v[wires[i].src] != num_v[to])
+            if (v != num_v[to])
             {
-                nw[num_e[i]].dests.push_back(num_v[to]);
+                edge_wire.push_back(num_e[i]);
+                edge_gate.push_back(num_v[to]);
                 setInput(num_v[to], num_e[i]);
             }
         }
     }
 
     // remove a trick to treat input-edge as a vertex
-    for (auto &p : input_vertices)
+    for (int i = 0; i < n_input; i++)
     {
-        ng[p.second].in1 = num_e[p.first];
-        ng[p.second].in2 = num_e[p.first];
+        if (input_vertices[i] != -1)
+        {
+            ng[input_vertices[i]].in1 = num_e[i];
+            ng[input_vertices[i]].in2 = num_e[i];
+        }
     }
     for (int i = 0; i < n_input; i++)
     {
-        wires[i].src = -1;
         nw[num_e[i]].src = -1;
         if (i < trick_add_ng_cnt)
             ng.pop_back();
@@ -256,14 +625,42 @@ CircuitGraph CircuitGraph::reduceSize()
     int countAND = 0;
     for (int i = 0; i < n_gate; i++)
     {
-        if (gates[i].type == AND)
+        if (graph.gate(i).type == AND)
         {
             ng[num_v[i]].type = AND;
             countAND++;
         }
     }
 
-    CircuitGraph newGraph(ng, nw, n_input, out_wires.size());
+    CircuitGraph newGraph(ng, nw, n_input, n_out_wires);
+
+    // stable counting sort of the edges by wire: the fan-outs of a wire keep
+    // the order they were found in
+    std::vector<int32_t> &begin = newGraph.fanout_begin;
+    begin.assign(nw.size() + 1, 0);
+    for (const int w : edge_wire)
+        begin[w + 1]++;
+    for (size_t w = 0; w < nw.size(); w++)
+        begin[w + 1] += begin[w];
+    std::vector<int32_t> pos(begin.begin(), begin.end() - 1);
+    newGraph.fanout.resize(edge_wire.size());
+    for (size_t k = 0; k < edge_wire.size(); k++)
+        newGraph.fanout[pos[edge_wire[k]]++] = edge_gate[k];
+    newGraph.buildLevels();
 
+    if (map != nullptr)
+        *map = ReductionMap(graph, newGraph, std::move(num_v),
+                            std::move(num_e));
     return newGraph;
 }
+
+template CircuitGraph CircuitGraph::reduceSize(const CircuitGraph &graph,
+                                               const int max_threads);
+template CircuitGraph CircuitGraph::reduceSize(const CircuitGraph &graph,
+                                               ReductionMap &map,
+                                               const int max_threads);
+template CircuitGraph CircuitGraph::reduceSize(const ExternalGraph &graph,
+                                               const int max_threads);
+template CircuitGraph CircuitGraph::reduceSize(const ExternalGraph &graph,
+                                               ReductionMap &map,
+                                               const int max_threads);
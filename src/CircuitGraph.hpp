@@ -1,6 +1,9 @@
 #ifndef _FHE_CIRCUIT_GRAPH
 #define _FHE_CIRCUIT_GRAPH
 
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -14,6 +17,43 @@ enum gate_type
     OUT
 };
 
+// file formats of circuits
+enum circuit_format
+{
+    FORMAT_BRISTOL,
+    FORMAT_BRISTOL_FASHION,
+    FORMAT_BLIF,
+    FORMAT_BINARY // see CircuitCache
+};
+
+// how CircuitGraph(filename) reads the file
+enum load_mode
+{
+    LOAD_STREAM,  // token by token through std::ifstream (plain Bristol only)
+    LOAD_MMAP,    // parse in place from a memory mapping (CircuitReader),
+                  // any circuit_format, plain or gzip / zstd compressed
+    LOAD_PARALLEL // LOAD_MMAP split into chunks parsed on several threads
+};
+
+// malformed circuit file; line is 1-based, 0 if not known (e.g. a net that
+// is never driven), filename is empty until the reader adds it
+class CircuitFormatError : public std::runtime_error
+{
+public:
+    const std::string filename;
+    const long line;
+    const std::string message;
+    CircuitFormatError(const std::string &_filename, const long _line,
+                       const std::string &_message)
+      : std::runtime_error(
+          (_filename.empty() ? "" : _filename + ":") +
+          (_line > 0 ? std::to_string(_line) + ":" : std::string()) +
+          (_filename.empty() && _line == 0 ? "" : " ") + _message),
+        filename(_filename),
+        line(_line),
+        message(_message){};
+};
+
 // gates and wires are 0-indexed
 class Gate
 {
@@ -24,20 +64,113 @@ public:
     Gate(int _in1, int _in2, int _out, gate_type _type)
       : in1(_in1), in2(_in2), out(_out), type(_type){};
     Gate(){};
+    bool operator==(const Gate &g) const
+    {
+        return in1 == g.in1 && in2 == g.in2 && out == g.out && type == g.type;
+    }
 };
 
+// the gates reading a wire are kept by CircuitGraph (fanout)
 class Wire
 {
 public:
     int src = -1; // source gate of this wire
     Wire(){};
-    std::vector<int> dests;
+    bool operator==(const Wire &w) const
+    {
+        return src == w.src;
+    }
+};
+
+// [begin, end) of int32 in place, e.g. the fan-outs of a wire
+class IndexRange
+{
+private:
+    const int32_t *b, *e;
+
+public:
+    IndexRange(const int32_t *_b, const int32_t *_e) : b(_b), e(_e){};
+    const int32_t *begin() const
+    {
+        return b;
+    }
+    const int32_t *end() const
+    {
+        return e;
+    }
+    size_t size() const
+    {
+        return e - b;
+    }
+    int operator[](const size_t i) const
+    {
+        return b[i];
+    }
 };
 
+// Gates as a structure of arrays: in1, in2 and out in arrays of their own,
+// the type in 2 bits per gate (32 gates per word), and the indices of the
+// gates of each type in increasing order. A scan that needs the type only
+// reads n_gate / 4 bytes, and one over the AND gates reads just their
+// indices.
+class PackedGates
+{
+private:
+    static const int TYPE_BITS = 2;
+    static const int PER_WORD = 64 / TYPE_BITS;
+
+    std::vector<int32_t> in1_, in2_, out_;
+    std::vector<uint64_t> types;
+    std::vector<int32_t> of_type[3]; // XOR, AND, INV
+
+public:
+    PackedGates(){};
+    explicit PackedGates(const std::vector<Gate> &gates);
+
+    size_t size() const
+    {
+        return out_.size();
+    }
+    int in1(const int i) const
+    {
+        return in1_[i];
+    }
+    int in2(const int i) const
+    {
+        return in2_[i];
+    }
+    int out(const int i) const
+    {
+        return out_[i];
+    }
+    gate_type type(const int i) const
+    {
+        const uint64_t word = types[i / PER_WORD];
+        return (gate_type)((word >> (TYPE_BITS * (i % PER_WORD))) & 3);
+    }
+    Gate gate(const int i) const
+    {
+        return Gate(in1_[i], in2_[i], out_[i], type(i));
+    }
+    // the gates of type t (XOR, AND or INV) in increasing order
+    const std::vector<int32_t> &ofType(const gate_type t) const
+    {
+        return of_type[t];
+    }
+
+    std::vector<Gate> unpack() const;
+    size_t memoryBytes() const;
+};
+
+class ReductionMap;
+
 class CircuitGraph
 {
 private:
-    CircuitGraph();
+    friend class CircuitCache;
+    friend class CircuitDecomposition;
+    friend class CircuitPasses;
+    CircuitGraph() : n_gate(0), n_wire(0), n_input(0), n_output(0){};
     CircuitGraph(const std::vector<Gate> &ng, const std::vector<Wire> &nw,
                  const int nin, const int nout)
       : n_gate(ng.size()),
@@ -46,6 +179,9 @@ private:
         n_output(nout),
         gates(ng),
         wires(nw){};
+    void readStream(const std::string &filename);
+
+    bool packed_mode = false;
 
 public:
     int n_gate;
@@ -53,12 +189,144 @@ public:
     int n_input;
     int n_output;
 
-    std::vector<Gate> gates;
+    std::vector<Gate> gates; // empty after packGates()
     std::vector<Wire> wires;
+    // fan-outs in compressed sparse row form: the gates reading wire w are
+    // fanout[fanout_begin[w] .. fanout_begin[w + 1]), in the order of the
+    // gates; fanout_begin has wires.size() + 1 entries
+    std::vector<int32_t> fanout_begin;
+    std::vector<int32_t> fanout;
+    // the gates in structure-of-arrays form, after packGates()
+    PackedGates packed;
+    // set by buildLevels(): the gates in a topological order (the file order
+    // whenever it is one), and for each gate the largest number of AND (XOR)
+    // gates on a path from the inputs to it, itself included
+    std::vector<int32_t> topo_order;
+    std::vector<int32_t> and_depth, xor_depth;
+
+    // max_threads is used by LOAD_PARALLEL only (0: all cores).
+    // Throws CircuitFormatError for a malformed file, also with NDEBUG.
+    CircuitGraph(const std::string &filename,
+                 const load_mode mode = LOAD_MMAP, const int max_threads = 0);
+
+    bool operator==(const CircuitGraph &g) const
+    {
+        return n_gate == g.n_gate && n_wire == g.n_wire &&
+               n_input == g.n_input && n_output == g.n_output &&
+               sameGates(g) && wires == g.wires &&
+               fanout_begin == g.fanout_begin && fanout == g.fanout;
+    }
+    // the same gates, whichever way each graph stores them
+    bool sameGates(const CircuitGraph &g) const;
 
-    CircuitGraph(const std::string &filename);
+    // switches gate storage to packed (gates is released) and back; the
+    // accessors below read either
+    void packGates();
+    void unpackGates();
+    bool isPacked() const
+    {
+        return packed_mode;
+    }
 
-    CircuitGraph reduceSize();
+    // sets fanout from gates in one counting pass (in1, and in2 except for
+    // INV); every loader calls it after the gates are read
+    void buildFanout();
+    // sets topo_order, and_depth and xor_depth from gates and fanout in
+    // linear time; every loader calls it after buildFanout. Throws
+    // CircuitFormatError if the gates form a cycle.
+    void buildLevels();
+    // multiplicative depth: the largest and_depth (0 without AND gates)
+    int andDepth() const;
+    // whether topo_order is the identity (no gate reads a later gate)
+    bool inTopologicalOrder() const;
+    // bytes held by the graph (gates or packed, wires, fanout and levels)
+    size_t memoryBytes() const;
+
+    // accessors shared with ExternalGraph, for the algorithms written for
+    // both (templates over the graph type)
+    Gate gate(const int i) const
+    {
+        return packed_mode ? packed.gate(i) : gates[i];
+    }
+    gate_type type(const int i) const
+    {
+        return packed_mode ? packed.type(i) : gates[i].type;
+    }
+    // calls fn(i) for the gates of type t in increasing order (from the
+    // index list of packed, or by a scan of gates)
+    template <class F>
+    void forEachGate(const gate_type t, F fn) const
+    {
+        if (packed_mode)
+        {
+            for (const int i : packed.ofType(t))
+                fn(i);
+            return;
+        }
+        for (int i = 0; i < n_gate; i++)
+            if (gates[i].type == t)
+                fn(i);
+    }
+    int src(const int w) const
+    {
+        return wires[w].src;
+    }
+    IndexRange dests(const int w) const
+    {
+        return IndexRange(fanout.data() + fanout_begin[w],
+                          fanout.data() + fanout_begin[w + 1]);
+    }
+    // number of gates reading the output of gate i
+    int fanoutCount(const int i) const
+    {
+        const int w = gate(i).out;
+        return fanout_begin[w + 1] - fanout_begin[w];
+    }
+
+    // the graph is only read (the work is done on buffers of the call), so
+    // one graph can be reduced and solved by several threads at once.
+    // max_threads other than 1 (0: all cores) reduces on several threads,
+    // with the same result (see CircuitGraphParallel.cpp)
+    CircuitGraph reduceSize(const int max_threads = 1) const;
+    // also sets map to the correspondence of the gates and wires of the two
+    // graphs (see ReductionMap.hpp)
+    CircuitGraph reduceSize(ReductionMap &map,
+                            const int max_threads = 1) const;
+    // reduceSize of any graph with the accessors above (CircuitGraph or
+    // ExternalGraph); graph is only read
+    template <class Graph>
+    static CircuitGraph reduceSize(const Graph &graph,
+                                   const int max_threads = 1);
+    template <class Graph>
+    static CircuitGraph reduceSize(const Graph &graph, ReductionMap &map,
+                                   const int max_threads = 1);
+    // reduceSize for the bootstrap problem, of a circuit as loaded (throws
+    // std::invalid_argument for a reduced graph). Before reducing, a gate
+    // whose operand stays at level 0 in every optimal solution (the inputs,
+    // and XOR / INV gates of such values only) is rewritten as if it read
+    // the other operand only: XOR(a, z) becomes INV(a), so that it is merged
+    // into a, and AND(a, z) becomes AND(a, a). The optimal number of
+    // bootstraps (BootstrapGurobiSolver) is that of reduceSize, on fewer
+    // vertices. map, if given, refers to the gates and wires of this graph
+    CircuitGraph reduceBootstrap(const int max_threads = 1) const;
+    CircuitGraph reduceBootstrap(ReductionMap &map,
+                                 const int max_threads = 1) const;
+    // the same result as reduceSize, through std::map / std::set as it was
+    // done before (O(n log n)); kept for reduceBench.out only
+    template <class Graph>
+    static CircuitGraph reduceSizeLegacy(const Graph &graph);
+
+private:
+    // the circuit reduceBootstrap hands to reduceSize
+    CircuitGraph bootstrapLevels() const;
+    // map may be null
+    template <class Graph>
+    static CircuitGraph reduceSizeSequential(const Graph &graph,
+                                             ReductionMap *map);
+    template <class Graph>
+    static CircuitGraph reduceSizeParallel(const Graph &graph,
+                                           const int num_threads,
+                                           ReductionMap *map);
 };
 
 #endif // _FHE_CIRCUIT_GRAPH
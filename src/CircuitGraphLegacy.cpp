@@ -0,0 +1,235 @@
+#include "CircuitGraph.hpp"
+
+#include <cassert>
+#include <map>
+#include <queue>
+#include <set>
+#include <vector>
+
+// reduceSize as it was before the renumbering used dense vectors only
+// (std::map / std::set, O(n log n)); the result is the same. Kept to
+// measure the new one against (reduceBench.out).
+template <class Graph>
+CircuitGraph CircuitGraph::reduceSizeLegacy(const Graph &graph)
+{
+    const int n_gate = graph.n_gate, n_wire = graph.n_wire;
+    const int n_input = graph.n_input, n_output = graph.n_output;
+
+    std::vector<int> num_v(n_gate, -1), num_e(n_wire, -1);
+    int usedIds = 0;
+    std::vector<int> num2v(n_wire, -1); // from new idx to old idx
+
+    std::queue<int> que; // queue of edge index
+    for (int i = 0; i < n_input; i++)
+    {
+        que.push(i);
+        num_e[i] = usedIds++;
+    }
+    for (int i = 0; i < n_gate; i++)
+    {
+        const Gate g = graph.gate(i);
+        if (g.type == AND)
+        {
+            que.push(g.out);
+            num_v[i] = usedIds++;
+            num2v[num_v[i]] = i;
+            num_e[g.out] = num_v[i];
+        }
+    }
+
+    while (!que.empty())
+    {
+        int i = que.front();
+        que.pop(); // edge(wire) index
+        for (const int gi : graph.dests(i))
+        {
+            const Gate g = graph.gate(gi);
+            if (g.type == AND)
+                continue;
+            bool toNext = false;
+            if (num_v[gi] == -1)
+            {
+                // first visit of the node
+                num_v[gi] = num_e[i];
+                if (g.type == INV)
+                    toNext = true;
+            }
+            else
+            {
+                // second visit of the node
+                if (num_v[gi] != num_e[i])
+                {
+                    num_v[gi] = usedIds++;
+                    num2v[num_v[gi]] = gi;
+                }
+                toNext = true;
+            }
+            if (toNext)
+            {
+                num_e[g.out] = num_v[gi];
+                que.push(g.out);
+            }
+        }
+    }
+
+    // edge_index -> num_v
+    std::map<int, int> input_vertices;
+
+    std::vector<Gate> ng;
+    std::vector<Wire> nw;
+
+    // input wires : the same as original
+    // output wires : build below
+    std::set<int> out_wires, general_wires;
+    {
+        // re-numbering wires and gates
+        std::map<int, int> nume2new_idx, numv2new_idx;
+        for (int i = n_wire - n_output; i < n_wire; i++)
+        {
+            if (num_e[i] >= n_input)
+                out_wires.insert(num_e[i]);
+        }
+        for (int i = n_input; i < n_wire - n_output; i++)
+        {
+            if (num_e[i] >= n_input &&
+                out_wires.find(num_e[i]) == out_wires.end())
+                general_wires.insert(num_e[i]);
+        }
+
+        int cnt = 0;
+        for (int i = 0; i < n_input; i++)
+            nume2new_idx[i] = cnt++;
+        for (auto i : general_wires)
+            nume2new_idx[i] = cnt++;
+        for (auto i : out_wires)
+            nume2new_idx[i] = cnt++;
+        nw.resize(cnt);
+
+        cnt = 0;
+        for (int i = 0; i < n_gate; i++)
+        {
+            if (numv2new_idx.find(num_v[i]) == numv2new_idx.end())
+                numv2new_idx[num_v[i]] = cnt++;
+        }
+        ng.resize(cnt);
+
+        for (int i = 0; i < n_gate; i++)
+        {
+            const Gate g = graph.gate(i);
+            if ((g.type == XOR && g.in1 == g.in2 && g.in1 != -1 &&
+                 num_e[g.in1] < n_input) ||
+                (g.type == INV && num_e[g.in1] < n_input))
+            {
+                input_vertices[num_e[g.in1]] = numv2new_idx[num_v[i]];
+            }
+        }
+
+        for (int i = 0; i < n_wire; i++)
+            num_e[i] = nume2new_idx[num_e[i]];
+        for (int i = 0; i < n_gate; i++)
+            num_v[i] = numv2new_idx[num_v[i]];
+    }
+
+    // trick to treat input-edge as a vertex: input wires get a pseudo
+    // source gate (kept here, the graph itself is not modified)
+    std::vector<int> input_src(n_input);
+    auto src = [&](int w) { return w < n_input ? input_src[w] : graph.src(w); };
+    int trick_add_ng_cnt = 0;
+    for (int i = 0; i < n_input; i++)
+    {
+        if (input_vertices.find(i) != input_vertices.end())
+        {
+            input_src[i] = num_v.size();
+            num_v.push_back(input_vertices[i]);
+        }
+        else
+        {
+            input_src[i] = num_v.size();
+            num_v.push_back(ng.size());
+            ng.push_back(Gate(-1, -1, i, INV));
+            trick_add_ng_cnt++;
+        }
+    }
+
+    // set input to new vertex v from wire w
+    auto setInput = [&](int v, int e)
+    {
+        if (ng[v].in1 == -1)
+        {
+            ng[v].in1 = e;
+        }
+        else
+        {
+            assert(ng[v].in2 == -1);
+            ng[v].in2 = e;
+        }
+    };
+
+    // fan-out edges (new wire, new gate) in the order they are found
+    std::vector<int32_t> edge_wire, edge_gate;
+    for (int i = 0; i < n_wire; i++)
+    {
+        const int v = num_v[src(i)];
+        assert(ng[v].out == -1 || ng[v].out == num_e[i]);
+        ng[v].out = num_e[i];
+        assert(nw[num_e[i]].src == -1 || nw[num_e[i]].src == v);
+        nw[num_e[i]].src = v;
+
+        for (const int to : graph.dests(i))
+        {
+            if (v != num_v[to])
+            {
+                edge_wire.push_back(num_e[i]);
+                edge_gate.push_back(num_v[to]);
+                setInput(num_v[to], num_e[i]);
+            }
+        }
+    }
+
+    // remove a trick to treat input-edge as a vertex
+    for (auto &p : input_vertices)
+    {
+        ng[p.second].in1 = num_e[p.first];
+        ng[p.second].in2 = num_e[p.first];
+    }
+    for (int i = 0; i < n_input; i++)
+    {
+        nw[num_e[i]].src = -1;
+        if (i < trick_add_ng_cnt)
+            ng.pop_back();
+    }
+
+    for (int i = 0; i < (int)ng.size(); i++)
+    {
+        ng[i].type = (ng[i].in2 == -1 ? INV : XOR);
+    }
+    int countAND = 0;
+    for (int i = 0; i < n_gate; i++)
+    {
+        if (graph.gate(i).type == AND)
+        {
+            ng[num_v[i]].type = AND;
+            countAND++;
+        }
+    }
+
+    CircuitGraph newGraph(ng, nw, n_input, out_wires.size());
+
+    // stable counting sort of the edges by wire: the fan-outs of a wire keep
+    // the order they were found in
+    std::vector<int32_t> &begin = newGraph.fanout_begin;
+    begin.assign(nw.size() + 1, 0);
+    for (const int w : edge_wire)
+        begin[w + 1]++;
+    for (size_t w = 0; w < nw.size(); w++)
+        begin[w + 1] += begin[w];
+    std::vector<int32_t> pos(begin.begin(), begin.end() - 1);
+    newGraph.fanout.resize(edge_wire.size());
+    for (size_t k = 0; k < edge_wire.size(); k++)
+        newGraph.fanout[pos[edge_wire[k]]++] = edge_gate[k];
+    newGraph.buildLevels();
+
+    return newGraph;
+}
+
+template CircuitGraph CircuitGraph::reduceSizeLegacy(const CircuitGraph &graph);
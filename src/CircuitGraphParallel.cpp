@@ -0,0 +1,483 @@
+#include "CircuitGraph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ExternalGraph.hpp"
+#include "Parallel.hpp"
+#include "ReductionMap.hpp"
+
+/*
+  reduceSize on several threads, with the same result as the sequential one.
+
+  The BFS of reduceSize gives a non-AND gate the id of its input when it has
+  one input (INV) or two inputs with the same id, and a new id otherwise,
+  handing out new ids in the order of a FIFO queue of wires. This is not a
+  union of components (an XOR of two clusters starts a cluster of its own
+  instead of joining them), so the ids are computed by the same BFS run level
+  by level: the wires queued while one level is processed form the next one,
+  in the order the FIFO queue holds them. In a large level the visits of
+  gates (events) are numbered by their position in the level and processed
+  in parallel; a gate completes at its last event, and new ids and the next
+  level follow the order of those events. Small levels, as in deep and
+  narrow circuits, are processed sequentially.
+
+  The renumbering and the wiring of the new graph are parallel passes over
+  dense arrays. Every order the sequential version depends on (first gate of
+  an id, input order of a gate, order of fan-outs) is recovered from gate or
+  event indices with atomic min, prefix sums or a sort of short runs.
+*/
+
+// levels of fewer wires are processed sequentially, and graphs of fewer
+// gates entirely so
+static const size_t PARALLEL_LEVEL = 4096;
+static const int PARALLEL_GATES = 1 << 16;
+
+template <class T>
+static void atomicMin(std::atomic<T> &a, const T v)
+{
+    T cur = a.load(std::memory_order_relaxed);
+    while (v < cur &&
+           !a.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+        ;
+}
+
+// sum[i] = f(0) + .. + f(i - 1) for i in [0, n], with the blocks of
+// parallelFor
+template <class F>
+static void prefixSum(const int num_threads, const long n, F f,
+                      std::vector<long> &sum)
+{
+    const int nt = (int)std::max(1L, std::min<long>(num_threads, n));
+    std::vector<long> block(nt + 1, 0);
+    sum.resize(n + 1);
+    parallelFor(nt, n, [&](int t, long b, long e) {
+        long s = 0;
+        for (long i = b; i < e; i++)
+        {
+            sum[i] = s;
+            s += f(i);
+        }
+        block[t + 1] = s;
+    });
+    for (int t = 0; t < nt; t++)
+        block[t + 1] += block[t];
+    parallelFor(nt, n, [&](int t, long b, long e) {
+        for (long i = b; i < e; i++)
+            sum[i] += block[t];
+    });
+    sum[n] = block[nt];
+}
+
+template <class T>
+static std::unique_ptr<std::atomic<T>[]> atomicArray(const int num_threads,
+                                                     const long n, const T v)
+{
+    std::unique_ptr<std::atomic<T>[]> a(new std::atomic<T>[std::max(1L, n)]);
+    parallelFor(num_threads, n, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+            a[i].store(v, std::memory_order_relaxed);
+    });
+    return a;
+}
+
+template <class Graph>
+CircuitGraph CircuitGraph::reduceSizeParallel(const Graph &graph,
+                                              const int num_threads,
+                                              ReductionMap *map)
+{
+    const int n_gate = graph.n_gate, n_wire = graph.n_wire;
+    const int n_input = graph.n_input, n_output = graph.n_output;
+    const int nt = num_threads;
+    std::vector<long> sum;
+    if (n_gate < PARALLEL_GATES)
+        return reduceSizeSequential(graph, map);
+
+    // the fan-outs of each wire are in gate order as every loader builds
+    // them; the order of fan-outs below relies on it
+    std::atomic<bool> in_gate_order(true);
+    parallelFor(nt, n_wire, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            const IndexRange d = graph.dests(i);
+            if (!std::is_sorted(d.begin(), d.end()))
+                in_gate_order = false;
+        }
+    });
+    if (!in_gate_order)
+        return reduceSizeSequential(graph, map);
+
+    std::vector<int> num_v(n_gate, -1), num_e(n_wire, -1);
+    int usedIds = n_input;
+
+    // the first level: input wires, then AND outputs in gate order
+    prefixSum(nt, n_gate, [&](long i) { return graph.type(i) == AND; }, sum);
+    const int n_and = sum[n_gate];
+    std::vector<int> level(n_input + n_and), next;
+    parallelFor(nt, n_input, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            level[i] = i;
+            num_e[i] = i;
+        }
+    });
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            if (sum[i + 1] == sum[i])
+                continue;
+            const int out = graph.gate(i).out;
+            level[n_input + sum[i]] = out;
+            num_v[i] = usedIds + sum[i];
+            num_e[out] = num_v[i];
+        }
+    });
+    usedIds += n_and;
+
+    // visits of an XOR so far, the events of its visits in parallel levels
+    // and the id of its second visit (num_v holds the first one)
+    auto visits = atomicArray<int>(nt, n_gate, 0);
+    std::vector<long> visit_event(2L * n_gate, -1);
+    std::vector<int> second_id(n_gate, -1);
+    long base = 0; // events of the levels before
+
+    std::vector<long> offset, done_sum, new_sum;
+    std::vector<int> done;  // per event: the gate completed there, or -1
+    std::vector<char> news; // per event: whether that gate gets a new id
+    while (!level.empty())
+    {
+        next.clear();
+        if (level.size() < PARALLEL_LEVEL)
+        {
+            // the sequential BFS, for this level
+            for (const int i : level)
+            {
+                for (const int gi : graph.dests(i))
+                {
+                    const gate_type type = graph.type(gi);
+                    if (type == AND)
+                        continue;
+                    const int v = visits[gi].load(std::memory_order_relaxed);
+                    visits[gi].store(v + 1, std::memory_order_relaxed);
+                    bool toNext = false;
+                    if (v == 0)
+                    {
+                        num_v[gi] = num_e[i];
+                        toNext = (type == INV);
+                    }
+                    else
+                    {
+                        if (num_v[gi] != num_e[i])
+                            num_v[gi] = usedIds++;
+                        toNext = true;
+                    }
+                    if (toNext)
+                    {
+                        const int out = graph.gate(gi).out;
+                        num_e[out] = num_v[gi];
+                        next.push_back(out);
+                    }
+                }
+            }
+            level.swap(next);
+            continue;
+        }
+
+        const long n = level.size();
+        prefixSum(nt, n, [&](long j) { return graph.dests(level[j]).size(); },
+                  offset);
+        const long n_event = offset[n];
+
+        // record the visits
+        parallelFor(nt, n, [&](int, long b, long e) {
+            for (long j = b; j < e; j++)
+            {
+                const int i = level[j];
+                long key = base + offset[j];
+                for (const int gi : graph.dests(i))
+                {
+                    const long k = key++;
+                    const gate_type type = graph.type(gi);
+                    if (type == INV)
+                        num_v[gi] = num_e[i];
+                    if (type != XOR)
+                        continue;
+                    const int v =
+                      visits[gi].fetch_add(1, std::memory_order_relaxed);
+                    if (v == 0)
+                        num_v[gi] = num_e[i];
+                    else
+                        second_id[gi] = num_e[i];
+                    visit_event[2L * gi + v] = k;
+                }
+            }
+        });
+
+        // the gates completed by each event
+        done.assign(n_event, -1);
+        news.assign(n_event, 0);
+        parallelFor(nt, n, [&](int, long b, long e) {
+            for (long j = b; j < e; j++)
+            {
+                long key = base + offset[j];
+                for (const int gi : graph.dests(level[j]))
+                {
+                    const long k = key++;
+                    const gate_type type = graph.type(gi);
+                    if (type == AND)
+                        continue;
+                    if (type == INV)
+                    {
+                        done[k - base] = gi;
+                    }
+                    else if (visits[gi].load(std::memory_order_relaxed) == 2 &&
+                             k == std::max(visit_event[2L * gi],
+                                           visit_event[2L * gi + 1]))
+                    {
+                        done[k - base] = gi;
+                        news[k - base] = (num_v[gi] != second_id[gi]);
+                    }
+                }
+            }
+        });
+
+        // the next level and the new ids, in the order of the events
+        prefixSum(nt, n_event, [&](long k) { return done[k] != -1; },
+                  done_sum);
+        prefixSum(nt, n_event, [&](long k) { return (long)news[k]; }, new_sum);
+        next.resize(done_sum[n_event]);
+        parallelFor(nt, n_event, [&](int, long b, long e) {
+            for (long k = b; k < e; k++)
+            {
+                const int gi = done[k];
+                if (gi == -1)
+                    continue;
+                if (news[k])
+                    num_v[gi] = usedIds + new_sum[k];
+                const int out = graph.gate(gi).out;
+                num_e[out] = num_v[gi];
+                next[done_sum[k]] = out;
+            }
+        });
+        usedIds += new_sum[n_event];
+        base += n_event;
+        level.swap(next);
+    }
+    visits.reset();
+    std::vector<long>().swap(visit_event);
+    std::vector<int>().swap(second_id);
+
+    // every gate and wire is reached (see reduceSize)
+    std::atomic<bool> reached(true);
+    parallelFor(nt, std::max(n_gate, n_wire), [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+            if ((i < n_gate && num_v[i] == -1) ||
+                (i < n_wire && num_e[i] == -1))
+                reached = false;
+    });
+    if (!reached)
+        throw CircuitFormatError("", 0, "gates or wires are not reached");
+
+    // re-numbering wires and gates (see reduceSize)
+    enum : char
+    {
+        ID_NONE,
+        ID_GENERAL,
+        ID_OUT
+    };
+    auto kind = atomicArray<char>(nt, usedIds, ID_NONE);
+    parallelFor(nt, n_output, [&](int, long b, long e) {
+        for (long i = n_wire - n_output + b; i < n_wire - n_output + e; i++)
+        {
+            if (num_e[i] >= n_input)
+                kind[num_e[i]].store(ID_OUT, std::memory_order_relaxed);
+        }
+    });
+    parallelFor(nt, n_wire - n_output - n_input, [&](int, long b, long e) {
+        for (long i = n_input + b; i < n_input + e; i++)
+        {
+            const int id = num_e[i];
+            if (id >= n_input &&
+                kind[id].load(std::memory_order_relaxed) != ID_OUT)
+                kind[id].store(ID_GENERAL, std::memory_order_relaxed);
+        }
+    });
+
+    std::vector<int> nume2new_idx(usedIds, -1);
+    std::vector<long> out_sum;
+    prefixSum(nt, usedIds,
+              [&](long id) { return kind[id].load() == ID_GENERAL; }, sum);
+    prefixSum(nt, usedIds, [&](long id) { return kind[id].load() == ID_OUT; },
+              out_sum);
+    const int n_general = sum[usedIds], n_out_wires = out_sum[usedIds];
+    parallelFor(nt, usedIds, [&](int, long b, long e) {
+        for (long id = b; id < e; id++)
+        {
+            const char k = kind[id].load(std::memory_order_relaxed);
+            if (k == ID_OUT)
+                nume2new_idx[id] = n_input + n_general + out_sum[id];
+            else if (k == ID_GENERAL)
+                nume2new_idx[id] = n_input + sum[id];
+            else if (id < n_input)
+                nume2new_idx[id] = id;
+        }
+    });
+    kind.reset();
+    std::vector<Wire> nw(n_input + n_general + n_out_wires);
+
+    // gates are numbered in the order their ids first appear
+    auto first = atomicArray<int>(nt, usedIds, INT_MAX);
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+            atomicMin(first[num_v[i]], (int)i);
+    });
+    prefixSum(nt, n_gate,
+              [&](long i) { return first[num_v[i]].load() == i; }, sum);
+    std::vector<int> numv2new_idx(usedIds, -1);
+    std::vector<char> is_first(n_gate, 0);
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            if (sum[i + 1] != sum[i])
+            {
+                numv2new_idx[num_v[i]] = sum[i];
+                is_first[i] = 1;
+            }
+        }
+    });
+    first.reset();
+    std::vector<Gate> ng(sum[n_gate]);
+
+    // a gate is the root of its id if it made the id (AND, or XOR of two
+    // ids); the other gates of an id take all their inputs from that id
+    std::vector<char> is_root(n_gate, 0);
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            const Gate g = graph.gate(i);
+            is_root[i] = (g.type == AND || num_v[i] != num_e[g.in1]);
+        }
+    });
+
+    // input wire -> new index of the gate that stands for it, or -1: the
+    // gates of an input id include one that reads only the input wire
+    std::vector<int> input_vertices(numv2new_idx.begin(),
+                                    numv2new_idx.begin() + n_input);
+
+    parallelFor(nt, n_wire, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+            num_e[i] = nume2new_idx[num_e[i]];
+    });
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+            num_v[i] = numv2new_idx[num_v[i]];
+    });
+    std::vector<int>().swap(nume2new_idx);
+    std::vector<int>().swap(numv2new_idx);
+
+    // the edges the sequential loop adds to a new gate are the inputs of
+    // its root, in increasing order of old wire, so every new gate has one
+    // writer: its first old gate for the source, its root for the inputs.
+    // Each input of a root takes a place among the fan-outs of its wire
+    auto n_fanout = atomicArray<int>(nt, nw.size(), 0);
+    std::vector<int32_t> place(2L * n_gate);
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            const Gate g = graph.gate(i);
+            const int v = num_v[i];
+            if (is_first[i])
+            {
+                ng[v].out = num_e[g.out];
+                nw[ng[v].out].src = v;
+            }
+            if (is_root[i])
+            {
+                ng[v].in1 = num_e[std::min(g.in1, g.in2)];
+                ng[v].in2 = num_e[std::max(g.in1, g.in2)];
+                place[2 * i] = n_fanout[num_e[g.in1]].fetch_add(
+                  1, std::memory_order_relaxed);
+                place[2 * i + 1] = n_fanout[num_e[g.in2]].fetch_add(
+                  1, std::memory_order_relaxed);
+            }
+        }
+    });
+    std::vector<char>().swap(is_first);
+
+    // fan-outs of a new wire in the order of the sequential loop: by old
+    // wire, then by gate (the fan-outs of an old wire are in gate order)
+    CircuitGraph newGraph;
+    std::vector<int32_t> &begin = newGraph.fanout_begin;
+    prefixSum(nt, nw.size(), [&](long w) { return n_fanout[w].load(); }, sum);
+    begin.assign(sum.begin(), sum.end());
+    n_fanout.reset();
+    // (old wire, old root)
+    std::vector<std::pair<int32_t, int32_t>> fanout(begin.back());
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            if (!is_root[i])
+                continue;
+            const Gate g = graph.gate(i);
+            fanout[begin[num_e[g.in1]] + place[2 * i]] = {g.in1, (int)i};
+            fanout[begin[num_e[g.in2]] + place[2 * i + 1]] = {g.in2, (int)i};
+        }
+    });
+    std::vector<int32_t>().swap(place);
+    std::vector<char>().swap(is_root);
+    newGraph.fanout.resize(fanout.size());
+    parallelFor(nt, nw.size(), [&](int, long b, long e) {
+        for (long w = b; w < e; w++)
+        {
+            std::sort(fanout.begin() + begin[w], fanout.begin() + begin[w + 1]);
+            for (int k = begin[w]; k < begin[w + 1]; k++)
+                newGraph.fanout[k] = num_v[fanout[k].second];
+        }
+    });
+    std::vector<std::pair<int32_t, int32_t>>().swap(fanout);
+
+    // input wires have no source; the gates standing for them read them
+    for (int i = 0; i < n_input; i++)
+    {
+        nw[num_e[i]].src = -1;
+        if (input_vertices[i] != -1)
+        {
+            ng[input_vertices[i]].in1 = num_e[i];
+            ng[input_vertices[i]].in2 = num_e[i];
+        }
+    }
+
+    parallelFor(nt, ng.size(), [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+            ng[i].type = (ng[i].in2 == -1 ? INV : XOR);
+    });
+    parallelFor(nt, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+            if (graph.type(i) == AND)
+                ng[num_v[i]].type = AND;
+    });
+
+    newGraph.n_gate = ng.size();
+    newGraph.n_wire = nw.size();
+    newGraph.n_input = n_input;
+    newGraph.n_output = n_out_wires;
+    newGraph.gates = std::move(ng);
+    newGraph.wires = std::move(nw);
+    newGraph.buildLevels();
+
+    if (map != nullptr)
+        *map = ReductionMap(graph, newGraph, std::move(num_v),
+                            std::move(num_e));
+    return newGraph;
+}
+
+template CircuitGraph
+CircuitGraph::reduceSizeParallel(const CircuitGraph &graph,
+                                 const int num_threads, ReductionMap *map);
+template CircuitGraph
+CircuitGraph::reduceSizeParallel(const ExternalGraph &graph,
+                                 const int num_threads, ReductionMap *map);
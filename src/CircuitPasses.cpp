@@ -0,0 +1,221 @@
+#include "CircuitPasses.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "CircuitBuilder.hpp"
+
+static void checkLoaded(const CircuitGraph &graph)
+{
+    // a loaded circuit has the sentinel wire read by INV gates
+    if (graph.wires.size() != (size_t)graph.n_wire + 1)
+        throw std::invalid_argument(
+          "circuit passes take a circuit as loaded, not a reduced graph");
+}
+
+// a builder with one net per input of graph: net[w] for those wires
+static void addInputs(const CircuitGraph &graph, CircuitBuilder &builder,
+                      std::vector<int> &net)
+{
+    net.assign(graph.n_wire, -1);
+    for (int i = 0; i < graph.n_input; i++)
+    {
+        net[i] = builder.addNet();
+        builder.setInput(net[i]);
+    }
+}
+
+CircuitGraph CircuitPasses::finish(const char *name,
+                                   const CircuitGraph &graph,
+                                   CircuitBuilder &builder, PassStats &stats)
+{
+    CircuitGraph result;
+    builder.build(result);
+    stats.name = name;
+    stats.removed_gates = graph.n_gate - result.n_gate;
+    stats.removed_edges =
+      (long)graph.fanout.size() - (long)result.fanout.size();
+    return result;
+}
+
+CircuitGraph CircuitPasses::removeDeadGates(const CircuitGraph &graph,
+                                            PassStats &stats)
+{
+    checkLoaded(graph);
+    const int first_output = graph.n_wire - graph.n_output;
+
+    // a gate is live if it drives an output or a live gate
+    std::vector<char> live(graph.n_gate, 0);
+    for (int k = graph.n_gate - 1; k >= 0; k--)
+    {
+        const int i = graph.topo_order[k];
+        const int out = graph.gate(i).out;
+        bool l = (out >= first_output);
+        for (const int d : graph.dests(out))
+            l = l || live[d];
+        live[i] = l;
+    }
+
+    CircuitBuilder builder;
+    std::vector<int> net;
+    addInputs(graph, builder, net);
+    for (const int i : graph.topo_order)
+    {
+        if (!live[i])
+            continue;
+        const Gate g = graph.gate(i);
+        net[g.out] = builder.addNet();
+        builder.addGate(g.type, net[g.in1], g.type == INV ? -1 : net[g.in2],
+                        net[g.out]);
+    }
+    for (int w = first_output; w < graph.n_wire; w++)
+        builder.setOutput(net[w]);
+    return finish("dead gates", graph, builder, stats);
+}
+
+CircuitGraph CircuitPasses::foldInverters(const CircuitGraph &graph,
+                                          PassStats &stats)
+{
+    checkLoaded(graph);
+    CircuitBuilder builder;
+    std::vector<int> net;
+    addInputs(graph, builder, net);
+
+    // the value of a wire: 2 * net + (1 if inverted), or the constant
+    // -1 - value
+    auto isConst = [](int l) { return l < 0; };
+    auto constValue = [](int l) { return -1 - l; };
+    auto invert = [](int l) { return l < 0 ? -3 - l : l ^ 1; };
+    std::vector<int> lit(graph.n_wire, -1);
+    for (int i = 0; i < graph.n_input; i++)
+        lit[i] = 2 * net[i];
+
+    // a net carrying a value: INV gates and constants are made once
+    std::vector<int> inverted;
+    int const_net[2] = {-1, -1};
+    auto netOf = [&](int l) {
+        if (isConst(l))
+        {
+            const int v = constValue(l);
+            if (const_net[v] == -1)
+            {
+                const_net[v] = builder.addNet();
+                builder.addFunction({}, {(uint8_t)v}, const_net[v]);
+            }
+            return const_net[v];
+        }
+        const int n = l >> 1;
+        if (!(l & 1))
+            return n;
+        if ((int)inverted.size() <= n)
+            inverted.resize(n + 1, -1);
+        if (inverted[n] == -1)
+        {
+            inverted[n] = builder.addNet();
+            builder.addGate(INV, n, -1, inverted[n]);
+        }
+        return inverted[n];
+    };
+
+    for (const int i : graph.topo_order)
+    {
+        const Gate g = graph.gate(i);
+        const int a = lit[g.in1];
+        if (g.type == INV)
+        {
+            lit[g.out] = invert(a);
+            continue;
+        }
+        const int b = lit[g.in2];
+        int &r = lit[g.out];
+        if (g.type == XOR)
+        {
+            if (isConst(a))
+                r = constValue(a) ? invert(b) : b;
+            else if (isConst(b))
+                r = constValue(b) ? invert(a) : a;
+            else if (a >> 1 == b >> 1)
+                r = -1 - ((a ^ b) & 1);
+            else
+            {
+                const int n = builder.addNet();
+                builder.addGate(XOR, netOf(a), netOf(b), n);
+                r = 2 * n;
+            }
+        }
+        else
+        {
+            if (isConst(a))
+                r = constValue(a) ? b : a;
+            else if (isConst(b))
+                r = constValue(b) ? a : b;
+            else if (a >> 1 == b >> 1)
+                r = (a == b ? a : -1);
+            else
+            {
+                const int n = builder.addNet();
+                builder.addGate(AND, netOf(a), netOf(b), n);
+                r = 2 * n;
+            }
+        }
+    }
+    for (int w = graph.n_wire - graph.n_output; w < graph.n_wire; w++)
+        builder.setOutput(netOf(lit[w]));
+    return finish("inverters", graph, builder, stats);
+}
+
+CircuitGraph CircuitPasses::hashGates(const CircuitGraph &graph,
+                                      PassStats &stats)
+{
+    checkLoaded(graph);
+    const int first_output = graph.n_wire - graph.n_output;
+    CircuitBuilder builder;
+    std::vector<int> net;
+    addInputs(graph, builder, net);
+
+    // (type, input nets) -> output net. Two outputs are not merged: the
+    // builder would copy one of them through two INV gates
+    std::unordered_map<uint64_t, int> made;
+    std::vector<char> is_output(graph.n_wire + graph.n_gate, 0);
+    for (const int i : graph.topo_order)
+    {
+        const Gate g = graph.gate(i);
+        int a = net[g.in1], b = (g.type == INV ? -1 : net[g.in2]);
+        if (a > b && b != -1)
+            std::swap(a, b);
+        const uint64_t key =
+          (uint64_t)g.type << 62 | (uint64_t)a << 31 | (uint32_t)(b + 1);
+        const bool output = (g.out >= first_output);
+        auto found = made.find(key);
+        if (found != made.end() && !(output && is_output[found->second]))
+        {
+            net[g.out] = found->second;
+        }
+        else
+        {
+            net[g.out] = builder.addNet();
+            builder.addGate(g.type, a, b, net[g.out]);
+            made[key] = net[g.out];
+        }
+        if (output)
+            is_output[net[g.out]] = 1;
+    }
+    for (int w = first_output; w < graph.n_wire; w++)
+        builder.setOutput(net[w]);
+    return finish("structural hashing", graph, builder, stats);
+}
+
+CircuitGraph CircuitPasses::simplify(const CircuitGraph &graph,
+                                     std::vector<PassStats> &stats)
+{
+    PassStats s;
+    CircuitGraph folded = foldInverters(graph, s);
+    stats.push_back(s);
+    CircuitGraph hashed = hashGates(folded, s);
+    stats.push_back(s);
+    CircuitGraph live = removeDeadGates(hashed, s);
+    stats.push_back(s);
+    return live;
+}
@@ -0,0 +1,50 @@
+#ifndef _FHE_CIRCUIT_PASSES
+#define _FHE_CIRCUIT_PASSES
+
+#include <string>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+
+class CircuitBuilder;
+
+// what one pass removed (negative if it added)
+class PassStats
+{
+public:
+    std::string name;
+    int removed_gates;
+    long removed_edges; // gate inputs (entries of fanout)
+};
+
+// Passes that shrink a circuit without changing what it computes, run
+// before the solvers (and before reduceSize) so that the models have fewer
+// variables. Each takes a circuit as loaded (not a reduced graph, for which
+// std::invalid_argument is thrown) and returns a new one, rebuilt through
+// CircuitBuilder: same inputs and outputs, gates in topological order.
+class CircuitPasses
+{
+private:
+    // builds the result and the statistics of a pass
+    static CircuitGraph finish(const char *name, const CircuitGraph &graph,
+                               CircuitBuilder &builder, PassStats &stats);
+
+public:
+    // removes the gates from which no output can be reached
+    static CircuitGraph removeDeadGates(const CircuitGraph &graph,
+                                        PassStats &stats);
+    // folds INV(INV(x)) into x, XOR(x, x), XOR(x, INV(x)) and AND(x, INV(x))
+    // into constants and AND(x, x) into x, and propagates constants; an INV
+    // is kept (once per value) only where a gate or an output reads it
+    static CircuitGraph foldInverters(const CircuitGraph &graph,
+                                      PassStats &stats);
+    // merges gates of the same type on the same inputs (structural hashing)
+    static CircuitGraph hashGates(const CircuitGraph &graph, PassStats &stats);
+
+    // foldInverters, hashGates and removeDeadGates, in this order; the
+    // statistics of each are appended to stats
+    static CircuitGraph simplify(const CircuitGraph &graph,
+                                 std::vector<PassStats> &stats);
+};
+
+#endif // _FHE_CIRCUIT_PASSES
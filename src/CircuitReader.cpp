@@ -0,0 +1,861 @@
+#include "CircuitReader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "CircuitBuilder.hpp"
+#include "CircuitCache.hpp"
+#include "CompressedInput.hpp"
+#include "ExternalGraph.hpp"
+#include "Parallel.hpp"
+
+// Whitespace separated tokenizer over a byte range, continued with the
+// blocks of source (if any) when the range runs out. Line numbers are only
+// counted when an error is reported.
+class TextScanner
+{
+private:
+    const char *p, *end;
+    CompressedInput *source;
+    const char *block;     // start of the current block
+    long lines_before = 0; // lines of the blocks before
+
+    static bool isSpace(const char c)
+    {
+        return (unsigned char)c <= ' ';
+    }
+
+public:
+    TextScanner(const char *_begin, const char *_end,
+                CompressedInput *_source = nullptr)
+      : p(_begin), end(_end), source(_source), block(_begin){};
+
+    void skipSpace()
+    {
+        while (true)
+        {
+            while (p != end && isSpace(*p))
+                ++p;
+            if (p != end || source == nullptr)
+                return;
+            // blocks end at a line boundary, so tokens are never split
+            const long lines = std::count(block, end, '\n');
+            if (!source->next(p, end))
+                return;
+            lines_before += lines;
+            block = p;
+        }
+    }
+
+    // 1-based line of at (in the current block)
+    long line(const char *at) const
+    {
+        return lines_before + std::count(block, at, '\n') + 1;
+    }
+
+    [[noreturn]] void fail(const std::string &message) const
+    {
+        throw CircuitFormatError("", line(p), message);
+    }
+
+    int readInt()
+    {
+        skipSpace();
+        const char *start = p;
+        bool neg = false;
+        if (p != end && *p == '-')
+        {
+            neg = true;
+            ++p;
+        }
+        const char *digits = p;
+        long v = 0;
+        while (p != end && (unsigned)(*p - '0') < 10 && v <= INT_MAX)
+        {
+            v = v * 10 + (*p - '0');
+            ++p;
+        }
+        if (p == digits || v > INT_MAX || (p != end && !isSpace(*p)))
+        {
+            p = start;
+            fail(p == end ? "unexpected end of file" : "expected an integer");
+        }
+        return neg ? -v : v;
+    }
+
+    // [b, e) points into the scanned bytes, nothing is copied
+    void readWord(const char *&b, const char *&e)
+    {
+        skipSpace();
+        b = p;
+        while (p != end && !isSpace(*p))
+            ++p;
+        e = p;
+    }
+
+    bool atEnd()
+    {
+        skipSpace();
+        return p == end;
+    }
+
+    const char *position() const
+    {
+        return p;
+    }
+};
+
+static bool isWord(const char *b, const char *e, const char *word)
+{
+    for (; b != e; ++b, ++word)
+    {
+        if (*word == '\0' || *b != *word)
+            return false;
+    }
+    return *word == '\0';
+}
+
+// reads the header of a Bristol file
+static void readBristolHeader(TextScanner &in, int &n_gate, int &n_wire,
+                              int &n_input, int &n_output)
+{
+    n_gate = in.readInt();
+    n_wire = in.readInt();
+    int n1 = in.readInt();
+    int n2 = in.readInt();
+    n_output = in.readInt();
+    // added in long: the counts are checked before they are used
+    const long inputs = (long)n1 + n2;
+    if (n_gate < 0 || n1 < 0 || n2 < 0 || n_output < 0 ||
+        n_gate + inputs != n_wire || n_output > n_wire - inputs)
+        in.fail("inconsistent header (n_gate + n_input != n_wire)");
+    n_input = inputs;
+}
+
+// reads the header of a Bristol file and sizes gates and wires
+static void readBristolHeader(TextScanner &in, CircuitGraph &graph)
+{
+    readBristolHeader(in, graph.n_gate, graph.n_wire, graph.n_input,
+                      graph.n_output);
+    graph.gates.resize(graph.n_gate);
+    graph.wires.resize(graph.n_wire + 1);
+}
+
+// reads one gate line, e.g. "2 1 in1 in2 out AND"
+static Gate readBristolGate(TextScanner &in, const int n_wire)
+{
+    int n_in = in.readInt();
+    int n_out = in.readInt();
+    if ((n_in != 1 && n_in != 2) || n_out != 1)
+        in.fail("a gate has 1 or 2 inputs and 1 output");
+
+    int in1 = in.readInt(), in2 = -1;
+    if (n_in == 2)
+        in2 = in.readInt();
+    int out = in.readInt();
+    const char *tb, *te;
+    in.readWord(tb, te);
+
+    // one branch for the usual case, details only for the error
+    const unsigned nw = n_wire;
+    if ((unsigned)in1 >= nw || (unsigned)out >= nw ||
+        (n_in == 2 && (unsigned)in2 >= nw))
+        in.fail("wire out of range [0, " + std::to_string(n_wire) + ")");
+
+    if (isWord(tb, te, "AND") || isWord(tb, te, "XOR"))
+    {
+        if (n_in != 2)
+            in.fail("AND/XOR has 2 inputs");
+        return Gate(in1, in2, out, tb[0] == 'A' ? AND : XOR);
+    }
+    else if (isWord(tb, te, "INV"))
+    {
+        if (n_in != 1)
+            in.fail("INV has 1 input");
+        return Gate(in1, n_wire, out, INV);
+    }
+    in.fail("unknown gate type '" + std::string(tb, te) + "'");
+}
+
+circuit_format CircuitReader::detectFormat(const MappedFile &file)
+{
+    return detectFormat(file.begin(), file.end());
+}
+
+circuit_format CircuitReader::detectFormat(const char *begin, const char *end)
+{
+    if (CircuitCache::isBinary(begin, end))
+        return FORMAT_BINARY;
+
+    const char *p = begin;
+
+    // Bristol starts with the gate count, BLIF with a directive or comment
+    while (p != end && (unsigned char)*p <= ' ')
+        ++p;
+    if (p != end && (*p == '.' || *p == '#'))
+        return FORMAT_BLIF;
+
+    // Bristol Fashion has an output header line where old Bristol has its
+    // first gate line (which ends with the gate mnemonic)
+    int line = 0;
+    while (p != end)
+    {
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        const char *b = p, *e = (nl == nullptr ? end : nl);
+        p = (nl == nullptr ? end : nl + 1);
+        while (b != e && (unsigned char)*b <= ' ')
+            ++b;
+        while (e != b && (unsigned char)e[-1] <= ' ')
+            --e;
+        if (b != e && ++line == 3)
+            return ((unsigned)(e[-1] - '0') < 10 ? FORMAT_BRISTOL_FASHION
+                                                 : FORMAT_BRISTOL);
+    }
+    return FORMAT_BRISTOL;
+}
+
+void CircuitReader::read(const std::string &filename, CircuitGraph &graph,
+                         const load_mode mode, const int max_threads)
+{
+    MappedFile file(filename);
+    try
+    {
+        if (CompressedInput::detect(file) != COMPRESSION_NONE)
+        {
+            readCompressed(file, graph);
+            return;
+        }
+
+        const circuit_format format = detectFormat(file);
+        if (format == FORMAT_BINARY)
+            readBinary(file, graph);
+        else if (format == FORMAT_BLIF)
+            readBlif(file, graph);
+        else if (format == FORMAT_BRISTOL_FASHION)
+            readBristolFashion(file, graph);
+        else if (mode == LOAD_PARALLEL)
+            readBristolParallel(file, graph, max_threads);
+        else
+            readBristol(file, graph);
+    }
+    catch (const CircuitFormatError &e)
+    {
+        throw CircuitFormatError(filename, e.line, e.message);
+    }
+}
+
+static void parseBristol(TextScanner &in, CircuitGraph &graph)
+{
+    readBristolHeader(in, graph);
+    const int n_gate = graph.n_gate, n_wire = graph.n_wire;
+    std::vector<Gate> &gates = graph.gates;
+    std::vector<Wire> &wires = graph.wires;
+
+    for (int i = 0; i < n_gate; ++i)
+    {
+        const Gate g = gates[i] = readBristolGate(in, n_wire);
+
+        // every wire should have just one input (or no, for inwire)
+        if (wires[g.out].src != -1 || g.out < graph.n_input)
+            in.fail("wire " + std::to_string(g.out) +
+                    (g.out < graph.n_input ? " is an input"
+                                           : " is driven twice"));
+        wires[g.out].src = i;
+    }
+    if (!in.atEnd())
+        in.fail("more gates than the header says");
+    graph.buildFanout();
+    graph.buildLevels();
+}
+
+void CircuitReader::readBristol(const MappedFile &file, CircuitGraph &graph)
+{
+    file.adviseSequential();
+    TextScanner in(file.begin(), file.end());
+    parseBristol(in, graph);
+}
+
+void CircuitReader::readBristolParallel(const MappedFile &file,
+                                        CircuitGraph &graph,
+                                        const int max_threads)
+{
+    const int num_threads = resolveThreads(max_threads);
+    TextScanner header(file.begin(), file.end());
+
+    readBristolHeader(header, graph);
+    const int n_gate = graph.n_gate, n_wire = graph.n_wire;
+    std::vector<Gate> &gates = graph.gates;
+    std::vector<Wire> &wires = graph.wires;
+
+    // split the gate section at line boundaries, one chunk per thread
+    const char *body = header.position(), *end = file.end();
+    std::vector<const char *> cuts(num_threads + 1, end);
+    cuts[0] = body;
+    for (int t = 1; t < num_threads; t++)
+    {
+        const char *p = body + (end - body) * t / num_threads;
+        p = std::max(p, cuts[t - 1]);
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        cuts[t] = (nl == nullptr ? end : nl + 1);
+    }
+
+    // a malformed file is read again sequentially, which reports the error
+    // with its line
+    std::atomic<bool> malformed(false);
+    auto fallback = [&]() {
+        graph.gates.clear();
+        graph.wires.clear();
+        graph.fanout.clear();
+        readBristol(file, graph);
+    };
+
+    // parse every chunk into its own gate buffer
+    std::vector<std::vector<Gate>> local(num_threads);
+    parallelFor(num_threads, num_threads, [&](int, long b, long e) {
+        for (long t = b; t < e; t++)
+        {
+            TextScanner in(cuts[t], cuts[t + 1]);
+            local[t].reserve((long)n_gate * (cuts[t + 1] - cuts[t]) /
+                               std::max(1L, (long)(end - body)) +
+                             16);
+            try
+            {
+                while (!in.atEnd())
+                    local[t].push_back(readBristolGate(in, n_wire));
+            }
+            catch (const CircuitFormatError &)
+            {
+                malformed = true;
+            }
+        }
+    });
+
+    std::vector<long> offset(num_threads + 1, 0);
+    for (int t = 0; t < num_threads; t++)
+        offset[t + 1] = offset[t] + local[t].size();
+    if (malformed || offset[num_threads] != n_gate)
+    {
+        fallback();
+        return;
+    }
+
+    // merge: count fan-outs and claim sources
+    std::unique_ptr<std::atomic<int>[]> count(new std::atomic<int>[n_wire + 1]);
+    std::unique_ptr<std::atomic<int>[]> src(new std::atomic<int>[n_wire + 1]);
+    parallelFor(num_threads, n_wire + 1, [&](int, long b, long e) {
+        for (long w = b; w < e; w++)
+        {
+            count[w].store(0, std::memory_order_relaxed);
+            src[w].store(-1, std::memory_order_relaxed);
+        }
+    });
+    parallelFor(num_threads, num_threads, [&](int, long b, long e) {
+        for (long t = b; t < e; t++)
+        {
+            int i = offset[t];
+            for (auto &g : local[t])
+            {
+                gates[i] = g;
+                count[g.in1].fetch_add(1, std::memory_order_relaxed);
+                if (g.type != INV)
+                    count[g.in2].fetch_add(1, std::memory_order_relaxed);
+
+                // every wire should have just one input (or no, for inwire)
+                int none = -1;
+                if (g.out < graph.n_input ||
+                    !src[g.out].compare_exchange_strong(
+                      none, i, std::memory_order_relaxed))
+                    malformed = true;
+                i++;
+            }
+            std::vector<Gate>().swap(local[t]);
+        }
+    });
+
+    if (malformed)
+    {
+        fallback();
+        return;
+    }
+
+    // merge: lay out the fan-out runs (the prefix sum is sequential), place
+    // fan-outs, then restore the sequential (gate) order within each run
+    std::vector<int32_t> &begin = graph.fanout_begin;
+    begin.resize(n_wire + 2);
+    begin[0] = 0;
+    for (int w = 0; w <= n_wire; w++)
+    {
+        wires[w].src = src[w].load(std::memory_order_relaxed);
+        begin[w + 1] = begin[w] + count[w].load(std::memory_order_relaxed);
+        count[w].store(begin[w], std::memory_order_relaxed);
+    }
+    std::vector<int32_t> &fanout = graph.fanout;
+    fanout.resize(begin.back());
+    parallelFor(num_threads, n_gate, [&](int, long b, long e) {
+        for (long i = b; i < e; i++)
+        {
+            const Gate &g = gates[i];
+            fanout[count[g.in1].fetch_add(1)] = i;
+            if (g.type != INV)
+                fanout[count[g.in2].fetch_add(1)] = i;
+        }
+    });
+    parallelFor(num_threads, n_wire + 1, [&](int, long b, long e) {
+        for (long w = b; w < e; w++)
+        {
+            if (begin[w + 1] - begin[w] > 1)
+                std::sort(fanout.begin() + begin[w],
+                          fanout.begin() + begin[w + 1]);
+        }
+    });
+    graph.buildLevels();
+}
+
+// the sum of the values of a Bristol Fashion header line ("n v_1 .. v_n")
+static long readFashionCounts(TextScanner &in)
+{
+    long total = 0;
+    const int n = in.readInt();
+    if (n < 0)
+        in.fail("negative count in header");
+    for (int v = 0; v < n; v++)
+    {
+        const int c = in.readInt();
+        if (c < 0)
+            in.fail("negative count in header");
+        total += c;
+    }
+    return total;
+}
+
+static void parseBristolFashion(TextScanner &in, CircuitGraph &graph)
+{
+    const int n_gate = in.readInt(), n_wire = in.readInt();
+    const long n_input = readFashionCounts(in);
+    const long n_output = readFashionCounts(in);
+    if (n_gate < 0 || n_wire < 0 || n_input + n_output > n_wire)
+        in.fail("inconsistent header (n_input + n_output > n_wire)");
+
+    // nets are the wires of the file
+    CircuitBuilder builder;
+    for (int w = 0; w < n_wire; w++)
+        builder.addNet();
+    for (int w = 0; w < n_input; w++)
+        builder.setInput(w);
+    for (int w = n_wire - n_output; w < n_wire; w++)
+        builder.setOutput(w);
+
+    std::vector<int> ports, ins(2);
+    const std::vector<uint8_t> or_truth = {0, 1, 1, 1};
+    const unsigned nw = n_wire;
+    try
+    {
+        for (int i = 0; i < n_gate; i++)
+        {
+            const int n_in = in.readInt(), n_out = in.readInt();
+            if (n_in < 0 || n_out < 1 || n_in + (long)n_out > 3L * n_wire + 2)
+                in.fail("wrong number of gate inputs / outputs");
+            ports.resize(n_in + n_out);
+            for (auto &w : ports)
+                w = in.readInt();
+            const char *tb, *te;
+            in.readWord(tb, te);
+
+            if (isWord(tb, te, "EQ"))
+            { // the input is a constant, not a wire
+                if (n_in != 1 || n_out != 1 || (ports[0] != 0 && ports[0] != 1))
+                    in.fail("EQ sets a wire to 0 or 1");
+                if ((unsigned)ports[1] >= nw)
+                    in.fail("wire out of range");
+                builder.addFunction({}, {(uint8_t)ports[0]}, ports[1]);
+                continue;
+            }
+            for (auto w : ports)
+                if ((unsigned)w >= nw)
+                    in.fail("wire out of range [0, " + std::to_string(n_wire) +
+                            ")");
+
+            if (isWord(tb, te, "AND") || isWord(tb, te, "XOR"))
+            {
+                if (n_in != 2 || n_out != 1)
+                    in.fail("AND/XOR has 2 inputs and 1 output");
+                builder.addGate(isWord(tb, te, "AND") ? AND : XOR, ports[0],
+                                ports[1], ports[2]);
+            }
+            else if (isWord(tb, te, "INV") || isWord(tb, te, "EQW"))
+            {
+                if (n_in != 1 || n_out != 1)
+                    in.fail("INV/EQW has 1 input and 1 output");
+                if (tb[0] == 'I')
+                    builder.addGate(INV, ports[0], -1, ports[1]);
+                else
+                    builder.addAlias(ports[0], ports[1]);
+            }
+            else if (isWord(tb, te, "MAND"))
+            { // "2k k a_1..a_k b_1..b_k c_1..c_k MAND": c_j = AND(a_j, b_j)
+                if (n_in != 2 * n_out)
+                    in.fail("MAND has 2k inputs and k outputs");
+                for (int j = 0; j < n_out; j++)
+                    builder.addGate(AND, ports[j], ports[n_out + j],
+                                    ports[n_in + j]);
+            }
+            else if (isWord(tb, te, "OR"))
+            {
+                if (n_in != 2 || n_out != 1)
+                    in.fail("OR has 2 inputs and 1 output");
+                ins[0] = ports[0];
+                ins[1] = ports[1];
+                builder.addFunction(ins, or_truth, ports[2]);
+            }
+            else
+                in.fail("unknown gate type '" + std::string(tb, te) + "'");
+        }
+    }
+    catch (const CircuitFormatError &e)
+    { // errors of the builder are on the gate just read
+        if (e.line != 0)
+            throw;
+        in.fail(e.message);
+    }
+    if (!in.atEnd())
+        in.fail("more gates than the header says");
+    builder.build(graph);
+}
+
+void CircuitReader::readBristolFashion(const MappedFile &file,
+                                       CircuitGraph &graph)
+{
+    file.adviseSequential();
+    TextScanner in(file.begin(), file.end());
+    parseBristolFashion(in, graph);
+}
+
+void CircuitReader::readBinary(const MappedFile &file, CircuitGraph &graph)
+{
+    std::vector<CircuitGraph> graphs;
+    uint64_t key;
+    if (!CircuitCache::read(file.begin(), file.end(), graphs, key) ||
+        graphs.empty())
+        throw CircuitFormatError(
+          "", 0, "truncated binary circuit or version other than " +
+                   std::to_string(CircuitCache::VERSION));
+    graph = std::move(graphs[0]);
+}
+
+// Streaming BLIF parser, fed one physical line at a time. Only the symbol
+// table and the .names table being read are kept; gates go straight to the
+// builder.
+class BlifParser
+{
+private:
+    CircuitBuilder builder;
+    std::unordered_map<std::string, int> nets;
+    std::string key, joined;
+    bool done = false;
+    long line_no = 0; // physical line being read
+
+    // the .names table being read
+    bool in_names = false;
+    std::vector<int> fn_in;
+    int fn_out = -1, fn_value = -1;
+    std::vector<uint8_t> fn_truth;
+
+    // the line is added by line()
+    [[noreturn]] static void fail(const std::string &message)
+    {
+        throw CircuitFormatError("", 0, message);
+    }
+
+    int net(const char *b, const char *e)
+    {
+        key.assign(b, e);
+        auto it = nets.find(key);
+        if (it != nets.end())
+            return it->second;
+        int n = builder.addNet();
+        nets.emplace(key, n);
+        return n;
+    }
+
+    void flushNames()
+    {
+        if (!in_names)
+            return;
+        if (fn_value == 0) // rows list the off-set
+        {
+            for (auto &t : fn_truth)
+                t ^= 1;
+        }
+        builder.addFunction(fn_in, fn_truth, fn_out);
+        in_names = false;
+    }
+
+    void directive(TextScanner &in)
+    {
+        const char *b, *e;
+        in.readWord(b, e);
+        flushNames();
+        if (isWord(b, e, ".inputs") || isWord(b, e, ".outputs"))
+        {
+            bool input = isWord(b, e, ".inputs");
+            while (!in.atEnd())
+            {
+                in.readWord(b, e);
+                if (input)
+                    builder.setInput(net(b, e));
+                else
+                    builder.setOutput(net(b, e));
+            }
+        }
+        else if (isWord(b, e, ".names"))
+        {
+            fn_in.clear();
+            while (!in.atEnd())
+            {
+                in.readWord(b, e);
+                fn_in.push_back(net(b, e));
+            }
+            if (fn_in.empty())
+                fail(".names without an output");
+            fn_out = fn_in.back();
+            fn_in.pop_back();
+            if (fn_in.size() > 16) // truth table of 2^16 entries
+                fail(".names with more than 16 inputs");
+            fn_truth.assign(1u << fn_in.size(), 0);
+            fn_value = -1;
+            in_names = true;
+        }
+        else if (isWord(b, e, ".end") || isWord(b, e, ".exdc"))
+        {
+            done = true; // only the first model is read
+        }
+        else if (isWord(b, e, ".latch") || isWord(b, e, ".subckt") ||
+                 isWord(b, e, ".gate") || isWord(b, e, ".mlatch"))
+        { // only combinational, flat netlists
+            fail("sequential or hierarchical BLIF (" + std::string(b, e) +
+                 ") is not supported");
+        }
+        // others (.model, timing information, ...) are ignored
+    }
+
+    // a row of the .names table, e.g. "1-0 1"
+    void row(TextScanner &in)
+    {
+        if (!in_names)
+            fail("table row outside .names");
+        const int k = fn_in.size();
+        const char *pb = nullptr, *pe = nullptr, *vb, *ve;
+        if (k > 0)
+            in.readWord(pb, pe);
+        in.readWord(vb, ve);
+        if (pe - pb != k || ve - vb != 1 || (*vb != '0' && *vb != '1') ||
+            !in.atEnd())
+            fail("malformed .names row (" + std::to_string(k) +
+                 " inputs)");
+        if (fn_value != -1 && fn_value != *vb - '0')
+            fail(".names mixes on-set and off-set rows");
+        fn_value = *vb - '0';
+
+        unsigned base = 0, dash = 0;
+        for (int j = 0; j < k; j++)
+        {
+            if (pb[j] == '1')
+                base |= 1u << j;
+            else if (pb[j] == '-')
+                dash |= 1u << j;
+            else if (pb[j] != '0')
+                fail("malformed .names row (" + std::to_string(k) +
+                     " inputs)");
+        }
+        // every assignment covered by the cube
+        for (unsigned sub = dash;; sub = (sub - 1) & dash)
+        {
+            fn_truth[base | sub] = 1;
+            if (sub == 0)
+                break;
+        }
+    }
+
+    void physical(const char *b, const char *e)
+    {
+        const char *hash = (const char *)memchr(b, '#', e - b);
+        if (hash != nullptr)
+            e = hash;
+        const char *last = e;
+        while (last != b && (unsigned char)last[-1] <= ' ')
+            --last;
+        if (last != b && last[-1] == '\\') // continued on the next line
+        {
+            joined.append(b, last - 1);
+            joined.push_back(' ');
+            return;
+        }
+        if (!joined.empty())
+        {
+            joined.append(b, e);
+            std::string whole;
+            whole.swap(joined);
+            physical(whole.data(), whole.data() + whole.size());
+            return;
+        }
+
+        TextScanner in(b, e);
+        if (in.atEnd())
+            return;
+        if (*in.position() == '.')
+            directive(in);
+        else
+            row(in);
+    }
+
+public:
+    void line(const char *b, const char *e)
+    {
+        line_no++;
+        if (done)
+            return;
+        try
+        {
+            physical(b, e);
+        }
+        catch (const CircuitFormatError &err)
+        { // errors of the builder are on this line too
+            if (err.line != 0)
+                throw;
+            throw CircuitFormatError("", line_no, err.message);
+        }
+    }
+
+    // every line of [b, e)
+    void lines(const char *b, const char *e)
+    {
+        while (b != e)
+        {
+            const char *nl = (const char *)memchr(b, '\n', e - b);
+            line(b, (nl == nullptr ? e : nl));
+            b = (nl == nullptr ? e : nl + 1);
+        }
+    }
+
+    void build(CircuitGraph &graph)
+    {
+        flushNames();
+        builder.build(graph);
+    }
+};
+
+void CircuitReader::readBlif(const MappedFile &file, CircuitGraph &graph)
+{
+    file.adviseSequential();
+    BlifParser parser;
+
+    // 64MB at a time, dropping the pages already read
+    const long release_step = 64 << 20;
+    const char *p = file.begin(), *end = file.end();
+    while (p != end)
+    {
+        const char *q = p + std::min(release_step, (long)(end - p));
+        const char *nl = (const char *)memchr(q, '\n', end - q);
+        q = (nl == nullptr ? end : nl + 1);
+        parser.lines(p, q);
+        file.release(q);
+        p = q;
+    }
+    parser.build(graph);
+}
+
+void CircuitReader::readCompressed(const MappedFile &file, CircuitGraph &graph)
+{
+    CompressedInput input(file);
+    const char *b = nullptr, *e = nullptr;
+    input.next(b, e);
+
+    // the first block holds a few MB of lines, enough to detect the format
+    const circuit_format format = detectFormat(b, e);
+    if (format == FORMAT_BINARY)
+    {
+        std::vector<char> bytes;
+        do
+            bytes.insert(bytes.end(), b, e);
+        while (input.next(b, e));
+        std::vector<CircuitGraph> graphs;
+        uint64_t key;
+        if (!CircuitCache::read(bytes.data(), bytes.data() + bytes.size(),
+                                graphs, key) ||
+            graphs.empty())
+            throw CircuitFormatError("", 0,
+                                     "truncated binary circuit or version "
+                                     "other than " +
+                                       std::to_string(CircuitCache::VERSION));
+        graph = std::move(graphs[0]);
+    }
+    else if (format == FORMAT_BLIF)
+    {
+        BlifParser parser;
+        do
+            parser.lines(b, e);
+        while (input.next(b, e));
+        parser.build(graph);
+    }
+    else
+    {
+        TextScanner in(b, e, &input);
+        if (format == FORMAT_BRISTOL_FASHION)
+            parseBristolFashion(in, graph);
+        else
+            parseBristol(in, graph);
+    }
+}
+
+// Bristol gates straight into builder; pages of mapped are dropped as the
+// gates are read
+static void parseBristol(TextScanner &in, ExternalGraphBuilder &builder,
+                         const MappedFile *mapped)
+{
+    int n_gate, n_wire, n_input, n_output;
+    readBristolHeader(in, n_gate, n_wire, n_input, n_output);
+    builder.begin(n_gate, n_wire, n_input, n_output);
+    for (int i = 0; i < n_gate; ++i)
+    {
+        builder.addGate(readBristolGate(in, n_wire));
+        if (mapped != nullptr && (i & 0xfffff) == 0xfffff)
+            mapped->release(in.position());
+    }
+    if (!in.atEnd())
+        in.fail("more gates than the header says");
+}
+
+void CircuitReader::readExternal(const std::string &filename,
+                                 ExternalGraphBuilder &builder)
+{
+    MappedFile file(filename);
+    try
+    {
+        if (CompressedInput::detect(file) != COMPRESSION_NONE)
+        {
+            CompressedInput input(file);
+            const char *b = nullptr, *e = nullptr;
+            input.next(b, e);
+            if (detectFormat(b, e) != FORMAT_BRISTOL)
+                throw CircuitFormatError("", 0, "not a Bristol circuit");
+            TextScanner in(b, e, &input);
+            parseBristol(in, builder, nullptr);
+            return;
+        }
+
+        if (detectFormat(file) != FORMAT_BRISTOL)
+            throw CircuitFormatError("", 0, "not a Bristol circuit");
+        file.adviseSequential();
+        TextScanner in(file.begin(), file.end());
+        parseBristol(in, builder, &file);
+    }
+    catch (const CircuitFormatError &e)
+    {
+        throw CircuitFormatError(filename, e.line, e.message);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef _FHE_CIRCUIT_READER
+#define _FHE_CIRCUIT_READER
+
+#include <string>
+
+#include "CircuitGraph.hpp"
+#include "MappedFile.hpp"
+
+class ExternalGraphBuilder;
+
+// Builds a CircuitGraph directly from the bytes of a circuit file.
+// Integers and gate mnemonics are parsed in place, without per-token
+// allocation.
+class CircuitReader
+{
+public:
+    // guesses the format from the first lines of the file
+    static circuit_format detectFormat(const MappedFile &file);
+    static circuit_format detectFormat(const char *begin, const char *end);
+
+    // reads the file in the format given by detectFormat, decompressing
+    // gzip / zstd files on the way; a malformed file raises
+    // CircuitFormatError (with the file name and, where known, the line)
+    static void read(const std::string &filename, CircuitGraph &graph,
+                     const load_mode mode = LOAD_MMAP,
+                     const int max_threads = 0);
+
+    // Bristol format (the format of CircuitGraph(filename))
+    static void readBristol(const MappedFile &file, CircuitGraph &graph);
+    // Bristol format, gate lines parsed on max_threads threads (0: all cores)
+    // and fan-outs merged in parallel; same result as readBristol
+    static void readBristolParallel(const MappedFile &file,
+                                    CircuitGraph &graph,
+                                    const int max_threads = 0);
+    // Bristol Fashion (multi-value input/output headers); EQ, EQW, MAND
+    // and OR are lowered into AND/XOR/INV
+    static void readBristolFashion(const MappedFile &file, CircuitGraph &graph);
+    // the first graph of a binary circuit file (see CircuitCache)
+    static void readBinary(const MappedFile &file, CircuitGraph &graph);
+    // BLIF (.inputs/.outputs/.names of the first .model), read in one pass;
+    // every .names table is lowered into AND/XOR/INV gates
+    static void readBlif(const MappedFile &file, CircuitGraph &graph);
+    // a gzip / zstd compressed file of any format, decompressed on a
+    // pipeline thread while the content is parsed (sequentially for every
+    // load_mode)
+    static void readCompressed(const MappedFile &file, CircuitGraph &graph);
+
+    // a Bristol file (plain or compressed) into builder, gate by gate,
+    // without a CircuitGraph in memory
+    static void readExternal(const std::string &filename,
+                             ExternalGraphBuilder &builder);
+};
+
+#endif // _FHE_CIRCUIT_READER
@@ -0,0 +1,129 @@
+#include "CircuitWriter.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "CircuitCache.hpp"
+
+// Buffered text output with a hand written integer formatter
+class TextOutput
+{
+private:
+    FILE *fp;
+    std::vector<char> buf;
+    size_t len = 0;
+
+public:
+    TextOutput(FILE *_fp) : fp(_fp), buf(1 << 16){};
+
+    void flush()
+    {
+        if (fwrite(buf.data(), 1, len, fp) != len)
+            throw std::runtime_error("cannot write circuit");
+        len = 0;
+    }
+    void put(const char c)
+    {
+        if (len == buf.size())
+            flush();
+        buf[len++] = c;
+    }
+    void put(const char *s)
+    {
+        while (*s)
+            put(*s++);
+    }
+    void put(const int v)
+    {
+        char digits[12];
+        int n = 0;
+        unsigned u = (v < 0 ? -(unsigned)v : v);
+        do
+        {
+            digits[n++] = '0' + u % 10;
+            u /= 10;
+        } while (u != 0);
+        if (v < 0)
+            put('-');
+        while (n > 0)
+            put(digits[--n]);
+    }
+};
+
+static void writeText(FILE *fp, const CircuitGraph &graph,
+                      const circuit_format format)
+{
+    // gates that drive an input wire get a fresh wire before the outputs
+    const int first_output = graph.n_wire - graph.n_output;
+    int n_fresh = 0;
+    for (int i = 0; i < graph.n_gate; i++)
+    {
+        if (graph.gate(i).out < graph.n_input)
+            n_fresh++;
+    }
+    const int n_wire = graph.n_wire + n_fresh;
+    auto wire = [&](int w) { return w < first_output ? w : w + n_fresh; };
+
+    TextOutput out(fp);
+    out.put(graph.n_gate);
+    out.put(' ');
+    out.put(n_wire);
+    out.put('\n');
+    if (format == FORMAT_BRISTOL_FASHION)
+    {
+        out.put("1 ");
+        out.put(graph.n_input);
+        out.put("\n1 ");
+        out.put(graph.n_output);
+    }
+    else
+    {
+        out.put(graph.n_input);
+        out.put(" 0 ");
+        out.put(graph.n_output);
+    }
+    out.put("\n\n");
+
+    int fresh = first_output;
+    for (int i = 0; i < graph.n_gate; i++)
+    {
+        const Gate g = graph.gate(i);
+        assert(g.in1 >= 0 && g.out >= 0);
+        const bool inv = (g.type == INV);
+        out.put(inv ? "1 1 " : "2 1 ");
+        out.put(wire(g.in1));
+        out.put(' ');
+        if (!inv)
+        {
+            out.put(wire(g.in2));
+            out.put(' ');
+        }
+        out.put(g.out < graph.n_input ? fresh++ : wire(g.out));
+        out.put(g.type == AND ? " AND\n" : (inv ? " INV\n" : " XOR\n"));
+    }
+    out.flush();
+}
+
+void CircuitWriter::write(const std::string &filename,
+                          const CircuitGraph &graph,
+                          const circuit_format format)
+{
+    if (format == FORMAT_BINARY)
+    {
+        CircuitCache::write(filename, {&graph});
+        return;
+    }
+    assert(format == FORMAT_BRISTOL || format == FORMAT_BRISTOL_FASHION);
+
+    // closed on every path; the explicit fclose reports write errors
+    std::unique_ptr<FILE, int (*)(FILE *)> fp(fopen(filename.c_str(), "w"),
+                                              fclose);
+    if (!fp)
+        throw std::runtime_error("cannot open " + filename);
+    writeText(fp.get(), graph, format);
+    if (fclose(fp.release()) != 0)
+        throw std::runtime_error("cannot write " + filename);
+}
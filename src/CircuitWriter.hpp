@@ -0,0 +1,23 @@
+#ifndef _FHE_CIRCUIT_WRITER
+#define _FHE_CIRCUIT_WRITER
+
+#include <string>
+
+#include "CircuitGraph.hpp"
+
+// Writes a CircuitGraph back out.
+//
+// FORMAT_BINARY (CircuitCache) keeps the graph exactly. The text formats
+// need every gate to drive a wire of its own; the vertices that reduceSize()
+// makes for input wires (XOR(i, i) or INV(i) with out = i) get a fresh wire
+// placed before the outputs, which nothing reads. Reading such a file back
+// gives a graph with the same gates, the same objectives for every solver,
+// and the Bristol invariants (n_gate + n_input == n_wire, inputs undriven).
+class CircuitWriter
+{
+public:
+    static void write(const std::string &filename, const CircuitGraph &graph,
+                      const circuit_format format);
+};
+
+#endif // _FHE_CIRCUIT_WRITER
@@ -0,0 +1,267 @@
+#include "CompressedInput.hpp"
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// gzip through inflate, member after member
+class GzipDecoder
+{
+private:
+    z_stream zs;
+    const unsigned char *in, *in_end;
+    bool done = false;
+
+    void feed()
+    {
+        if (zs.avail_in == 0 && in != in_end)
+        {
+            size_t n = std::min<size_t>(in_end - in,
+                                        std::numeric_limits<uInt>::max());
+            zs.next_in = const_cast<Bytef *>(in);
+            zs.avail_in = n;
+            in += n;
+        }
+    }
+
+public:
+    GzipDecoder(const char *begin, const char *end)
+      : in((const unsigned char *)begin), in_end((const unsigned char *)end)
+    {
+        memset(&zs, 0, sizeof(zs));
+        // 15: largest window, +32: detect the header
+        if (inflateInit2(&zs, 15 + 32) != Z_OK)
+            throw std::runtime_error("cannot initialize zlib");
+    }
+    ~GzipDecoder()
+    {
+        inflateEnd(&zs);
+    }
+
+    // up to cap bytes into out; 0 at the end of the data
+    size_t read(char *out, size_t cap)
+    {
+        cap = std::min<size_t>(cap, std::numeric_limits<uInt>::max());
+        zs.next_out = (Bytef *)out;
+        zs.avail_out = cap;
+        while (!done && zs.avail_out == cap)
+        {
+            feed();
+            int ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END)
+            {
+                feed();
+                // skip the zero padding some tools append
+                while (zs.avail_in > 0 && *zs.next_in == 0)
+                {
+                    zs.next_in++;
+                    zs.avail_in--;
+                    feed();
+                }
+                if (zs.avail_in == 0)
+                    done = true;
+                else if (inflateReset(&zs) != Z_OK)
+                    throw std::runtime_error("corrupt gzip data");
+            }
+            else if (ret == Z_BUF_ERROR && zs.avail_in == 0)
+                throw std::runtime_error("truncated gzip data");
+            else if (ret != Z_OK)
+                throw std::runtime_error("corrupt gzip data");
+        }
+        return cap - zs.avail_out;
+    }
+};
+
+#ifdef HAVE_ZSTD
+class ZstdDecoder
+{
+private:
+    ZSTD_DStream *zs;
+    ZSTD_inBuffer in;
+    size_t last = 0; // 0 when the last frame read is complete
+
+public:
+    ZstdDecoder(const char *begin, const char *end)
+    {
+        zs = ZSTD_createDStream();
+        if (zs == nullptr || ZSTD_isError(ZSTD_initDStream(zs)))
+            throw std::runtime_error("cannot initialize zstd");
+        in = {begin, (size_t)(end - begin), 0};
+    }
+    ~ZstdDecoder()
+    {
+        ZSTD_freeDStream(zs);
+    }
+
+    size_t read(char *out, size_t cap)
+    {
+        ZSTD_outBuffer ob = {out, cap, 0};
+        while (ob.pos == 0 && in.pos < in.size)
+        {
+            last = ZSTD_decompressStream(zs, &ob, &in);
+            if (ZSTD_isError(last))
+                throw std::runtime_error("corrupt zstd data");
+        }
+        if (ob.pos == 0 && last != 0)
+        {
+            // the frame may still hold data buffered in the decoder
+            last = ZSTD_decompressStream(zs, &ob, &in);
+            if (ZSTD_isError(last) || (ob.pos == 0 && last != 0))
+                throw std::runtime_error("truncated zstd data");
+        }
+        return ob.pos;
+    }
+};
+#endif
+
+compression_type CompressedInput::detect(const MappedFile &file)
+{
+    const unsigned char *p = (const unsigned char *)file.begin();
+    if (file.size() >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+        return COMPRESSION_GZIP;
+    if (file.size() >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f &&
+        p[3] == 0xfd)
+        return COMPRESSION_ZSTD;
+    return COMPRESSION_NONE;
+}
+
+CompressedInput::CompressedInput(const MappedFile &_file)
+  : file(_file), type(detect(_file))
+{
+    assert(type != COMPRESSION_NONE);
+#ifndef HAVE_ZSTD
+    if (type == COMPRESSION_ZSTD)
+        throw std::runtime_error("zstd input needs a build with ZSTD=1");
+#endif
+    file.adviseSequential();
+    worker = std::thread(&CompressedInput::run, this);
+}
+
+CompressedInput::~CompressedInput()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopped = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+std::vector<char> CompressedInput::takeSpare()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (spare.empty())
+        return std::vector<char>();
+    std::vector<char> block;
+    block.swap(spare.back());
+    spare.pop_back();
+    return block;
+}
+
+bool CompressedInput::push(std::vector<char> &block)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return stopped || queue.size() < QUEUE_BLOCKS; });
+    if (stopped)
+        return false;
+    queue.emplace_back();
+    queue.back().swap(block);
+    cv.notify_all();
+    return true;
+}
+
+template <class Decoder>
+void CompressedInput::produce(Decoder &decoder)
+{
+    std::vector<char> block = takeSpare();
+    block.resize(BLOCK_SIZE);
+    size_t len = 0;
+    while (true)
+    {
+        size_t n = decoder.read(block.data() + len, block.size() - len);
+        len += n;
+        if (n == 0 || len == block.size())
+        {
+            // hand over the complete lines, keep the rest for the next block
+            size_t cut = len;
+            if (n != 0)
+            {
+                const char *nl =
+                  (const char *)memrchr(block.data(), '\n', len);
+                if (nl == nullptr)
+                { // a line longer than the block
+                    block.resize(block.size() * 2);
+                    continue;
+                }
+                cut = nl + 1 - block.data();
+            }
+            std::vector<char> rest = takeSpare();
+            rest.resize(std::max<size_t>(size_t(BLOCK_SIZE), 2 * (len - cut)));
+            memcpy(rest.data(), block.data() + cut, len - cut);
+            block.resize(cut);
+            if (cut > 0 && !push(block))
+                return;
+            block.swap(rest);
+            len -= cut;
+        }
+        if (n == 0)
+            return;
+    }
+}
+
+void CompressedInput::run()
+{
+    try
+    {
+        if (type == COMPRESSION_GZIP)
+        {
+            GzipDecoder decoder(file.begin(), file.end());
+            produce(decoder);
+        }
+#ifdef HAVE_ZSTD
+        else if (type == COMPRESSION_ZSTD)
+        {
+            ZstdDecoder decoder(file.begin(), file.end());
+            produce(decoder);
+        }
+#endif
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    finished = true;
+    cv.notify_all();
+}
+
+bool CompressedInput::next(const char *&b, const char *&e)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    if (!current.empty())
+    {
+        spare.emplace_back();
+        spare.back().swap(current);
+    }
+    cv.wait(lock, [&] { return finished || !queue.empty(); });
+    if (queue.empty())
+    {
+        if (error)
+            std::rethrow_exception(error);
+        return false;
+    }
+    current.swap(queue.front());
+    queue.pop_front();
+    cv.notify_all();
+    b = current.data();
+    e = b + current.size();
+    return true;
+}
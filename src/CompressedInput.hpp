@@ -0,0 +1,64 @@
+#ifndef _FHE_COMPRESSED_INPUT
+#define _FHE_COMPRESSED_INPUT
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+enum compression_type
+{
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP, // also concatenated gzip members
+    COMPRESSION_ZSTD  // only if built with HAVE_ZSTD (make ZSTD=1)
+};
+
+// Decompresses a mapped file on a thread of its own and hands the content
+// to the reader in blocks (a few MB each) that end at a line boundary, so
+// that a token never spans two blocks. At most QUEUE_BLOCKS blocks are
+// buffered; decompression and parsing overlap.
+class CompressedInput
+{
+private:
+    static const size_t BLOCK_SIZE = 4 << 20;
+    static const size_t QUEUE_BLOCKS = 4;
+
+    const MappedFile &file;
+    const compression_type type;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::vector<char>> queue;
+    std::vector<std::vector<char>> spare; // consumed blocks for reuse
+    std::vector<char> current;
+    bool finished = false, stopped = false;
+    std::exception_ptr error;
+    std::thread worker;
+
+    void run();
+    template <class Decoder>
+    void produce(Decoder &decoder);
+    std::vector<char> takeSpare();
+    // false if the reader has gone
+    bool push(std::vector<char> &block);
+
+public:
+    // magic bytes of gzip / zstd at the start of the file
+    static compression_type detect(const MappedFile &file);
+
+    CompressedInput(const MappedFile &_file);
+    ~CompressedInput();
+    CompressedInput(const CompressedInput &) = delete;
+    CompressedInput &operator=(const CompressedInput &) = delete;
+
+    // the next block [b, e), valid until the next call; false at the end.
+    // Decompression errors (corrupt or truncated data) are thrown here as
+    // std::runtime_error.
+    bool next(const char *&b, const char *&e);
+};
+
+#endif // _FHE_COMPRESSED_INPUT
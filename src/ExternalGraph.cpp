@@ -0,0 +1,318 @@
+#include "ExternalGraph.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+#include "BinaryFormat.hpp"
+#include "CircuitCache.hpp"
+#include "CircuitReader.hpp"
+
+// an anonymous temporary file, removed when closed
+static FILE *openTemporary(const std::string &dir)
+{
+    std::string path = dir + "/fhe-run-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+        throw std::runtime_error("cannot create a run file in " + dir);
+    unlink(path.c_str());
+    FILE *fp = fdopen(fd, "w+b");
+    if (fp == nullptr)
+    {
+        close(fd);
+        throw std::runtime_error("cannot open a run file in " + dir);
+    }
+    return fp;
+}
+
+static FILE *openAt(const std::string &filename, const long offset)
+{
+    FILE *fp = fopen(filename.c_str(), "r+b");
+    if (fp == nullptr || fseek(fp, offset, SEEK_SET) != 0)
+        throw std::runtime_error("cannot open " + filename);
+    return fp;
+}
+
+static void closeWritten(FILE *fp, const std::string &filename)
+{
+    if (fclose(fp) != 0)
+        throw std::runtime_error("cannot write " + filename);
+}
+
+// Sequential reader of a sorted run
+class RunReader
+{
+private:
+    FILE *fp;
+    std::vector<uint64_t> buf;
+    size_t pos = 0, len = 0;
+
+public:
+    RunReader(FILE *_fp, const size_t entries) : fp(_fp), buf(entries)
+    {
+        rewind(fp);
+    }
+    bool next(uint64_t &v)
+    {
+        if (pos == len)
+        {
+            len = fread(buf.data(), sizeof(uint64_t), buf.size(), fp);
+            pos = 0;
+            if (len == 0)
+                return false;
+        }
+        v = buf[pos++];
+        return true;
+    }
+};
+
+ExternalGraphBuilder::ExternalGraphBuilder(const std::string &_filename,
+                                           const std::string &_tmp_dir,
+                                           const size_t memory_bytes)
+  : filename(_filename),
+    tmp_dir(_tmp_dir),
+    run_entries(std::max<size_t>(memory_bytes / sizeof(uint64_t), 1 << 16))
+{
+}
+
+ExternalGraphBuilder::~ExternalGraphBuilder()
+{
+    for (auto run : runs)
+        fclose(run);
+    if (fp != nullptr)
+        fclose(fp);
+}
+
+void ExternalGraphBuilder::begin(const int _n_gate, const int _n_wire,
+                                 const int _n_input, const int _n_output)
+{
+    n_gate = _n_gate;
+    n_wire = _n_wire;
+    n_input = _n_input;
+    n_output = _n_output;
+    const long n_slot = n_wire + 1;
+
+    const long off_gates = FILE_HEADER_SIZE + GRAPH_HEADER_SIZE;
+    off_src = off_gates + align8(16L * n_gate);
+    off_begin = off_src + align8(4 * n_slot);
+    off_dests = off_begin + align8(4 * (n_slot + 1));
+
+    fp = fopen(filename.c_str(), "wb");
+    if (fp == nullptr || fseek(fp, off_gates, SEEK_SET) != 0)
+        throw std::runtime_error("cannot open " + filename);
+    gates_out.reset(new BinaryOutput(fp));
+    pairs.reserve(run_entries);
+}
+
+void ExternalGraphBuilder::spill()
+{
+    std::sort(pairs.begin(), pairs.end());
+    FILE *run = openTemporary(tmp_dir);
+    runs.push_back(run);
+    if (fwrite(pairs.data(), sizeof(uint64_t), pairs.size(), run) !=
+        pairs.size())
+        throw std::runtime_error("cannot write a run file in " + tmp_dir);
+    pairs.clear();
+}
+
+void ExternalGraphBuilder::addGate(const Gate &g)
+{
+    assert(n_added < n_gate);
+    const uint64_t i = n_added++;
+    gates_out->i32(g.in1);
+    gates_out->i32(g.in2);
+    gates_out->i32(g.out);
+    gates_out->i32(g.type);
+
+    if (pairs.size() + 3 > run_entries)
+        spill();
+    pairs.push_back((uint64_t)g.in1 << 32 | i << 1 | 1);
+    if (g.type != INV)
+        pairs.push_back((uint64_t)g.in2 << 32 | i << 1 | 1);
+    pairs.push_back((uint64_t)g.out << 32 | i << 1);
+    n_dest += (g.type == INV ? 1 : 2);
+}
+
+void ExternalGraphBuilder::finish()
+{
+    assert(n_added == n_gate);
+    gates_out->align();
+    gates_out.reset();
+
+    // merge the runs (or just sort, if everything fit in memory)
+    std::vector<std::unique_ptr<RunReader>> readers;
+    typedef std::pair<uint64_t, int> head;
+    std::priority_queue<head, std::vector<head>, std::greater<head>> heads;
+    if (runs.empty())
+        std::sort(pairs.begin(), pairs.end());
+    else
+    {
+        if (!pairs.empty())
+            spill();
+        std::vector<uint64_t>().swap(pairs);
+        const size_t entries =
+          std::max<size_t>(run_entries / runs.size(), 4096);
+        for (int r = 0; r < (int)runs.size(); r++)
+        {
+            readers.emplace_back(new RunReader(runs[r], entries));
+            uint64_t v;
+            if (readers[r]->next(v))
+                heads.push(head(v, r));
+        }
+    }
+    size_t next_pair = 0;
+    auto next = [&](uint64_t &v) {
+        if (readers.empty())
+        {
+            if (next_pair == pairs.size())
+                return false;
+            v = pairs[next_pair++];
+            return true;
+        }
+        if (heads.empty())
+            return false;
+        head h = heads.top();
+        heads.pop();
+        v = h.first;
+        uint64_t u;
+        if (readers[h.second]->next(u))
+            heads.push(head(u, h.second));
+        return true;
+    };
+
+    FILE *src_fp = openAt(filename, off_src);
+    FILE *begin_fp = openAt(filename, off_begin);
+    FILE *dests_fp = openAt(filename, off_dests);
+    {
+        BinaryOutput src_out(src_fp), begin_out(begin_fp), dests_out(dests_fp);
+        const int n_slot = n_wire + 1;
+        int w = 0, cur_src = -1;
+        long pos = 0, wire_begin = 0;
+        auto closeWire = [&]() {
+            // every wire should have just one input (or no, for inwire)
+            if (w < n_input && cur_src != -1)
+                throw CircuitFormatError("", 0,
+                                         "input wire " + std::to_string(w) +
+                                           " is driven by gate " +
+                                           std::to_string(cur_src));
+            src_out.i32(cur_src);
+            begin_out.i32(wire_begin);
+            wire_begin = pos;
+            cur_src = -1;
+            w++;
+        };
+        uint64_t v;
+        while (next(v))
+        {
+            const int vw = v >> 32, gi = (v >> 1) & 0x7fffffff;
+            assert(vw < n_slot);
+            while (w < vw)
+                closeWire();
+            if (v & 1)
+            {
+                dests_out.i32(gi);
+                pos++;
+            }
+            else
+            {
+                if (cur_src != -1)
+                    throw CircuitFormatError(
+                      "", 0, "wire " + std::to_string(vw) +
+                               " is driven by gates " +
+                               std::to_string(cur_src) + " and " +
+                               std::to_string(gi));
+                cur_src = gi;
+            }
+        }
+        while (w < n_slot)
+            closeWire();
+        begin_out.i32(pos);
+        assert(pos == n_dest);
+        src_out.align();
+        begin_out.align();
+        dests_out.align();
+    }
+    closeWritten(src_fp, filename);
+    closeWritten(begin_fp, filename);
+    closeWritten(dests_fp, filename);
+
+    readers.clear();
+    for (auto run : runs)
+        fclose(run);
+    runs.clear();
+
+    // the header, now that n_dest is known
+    if (fseek(fp, 0, SEEK_SET) != 0)
+        throw std::runtime_error("cannot write " + filename);
+    {
+        BinaryOutput out(fp);
+        out.bytes(MAGIC, sizeof(MAGIC));
+        out.i32(CircuitCache::VERSION);
+        out.i32(1);
+        out.u64(0);
+        out.i32(n_gate);
+        out.i32(n_wire);
+        out.i32(n_input);
+        out.i32(n_output);
+        out.i32(n_wire + 1);
+        out.i32(n_dest);
+        out.flush();
+    }
+    closeWritten(fp, filename);
+    fp = nullptr;
+}
+
+ExternalGraph::ExternalGraph(const std::string &filename, const int index)
+  : file(filename)
+{
+    // arrays are used in place
+    if (!hostIsLittleEndian())
+        throw std::runtime_error("ExternalGraph needs a little-endian host");
+
+    BinaryInput in(file.begin(), file.end());
+    int n_graphs;
+    uint64_t key;
+    if (!readFileHeader(in, CircuitCache::VERSION, n_graphs, key) ||
+        index < 0 || index >= n_graphs)
+        throw std::runtime_error(filename + " has no binary circuit graph " +
+                                 std::to_string(index));
+    BinaryGraph g;
+    for (int k = 0; k <= index; k++)
+    {
+        if (!readGraph(in, g))
+            throw std::runtime_error(filename + " is truncated");
+    }
+    // the arrays are indexed unchecked from here on
+    if (const char *message = checkGraph(g))
+        throw CircuitFormatError(filename, 0, message);
+
+    n_gate = g.n_gate;
+    n_wire = g.n_wire;
+    n_input = g.n_input;
+    n_output = g.n_output;
+    gates_ = reinterpret_cast<const int32_t *>(g.gates);
+    src_ = reinterpret_cast<const int32_t *>(g.src);
+    dest_begin_ = reinterpret_cast<const int32_t *>(g.dest_begin);
+    dests_ = reinterpret_cast<const int32_t *>(g.dests);
+}
+
+void ExternalGraph::build(const std::string &circuit_filename,
+                          const std::string &graph_filename,
+                          const std::string &tmp_dir,
+                          const size_t memory_bytes)
+{
+    ExternalGraphBuilder builder(graph_filename, tmp_dir, memory_bytes);
+    CircuitReader::readExternal(circuit_filename, builder);
+    try
+    {
+        builder.finish();
+    }
+    catch (const CircuitFormatError &e)
+    {
+        throw CircuitFormatError(circuit_filename, e.line, e.message);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef _FHE_EXTERNAL_GRAPH
+#define _FHE_EXTERNAL_GRAPH
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+#include "MappedFile.hpp"
+
+class BinaryOutput;
+
+// Writes a binary circuit (CircuitCache format, one graph) from gates given
+// in order, using about memory_bytes of memory whatever the circuit size:
+// gates go straight to the file, and the (wire, gate) pairs of sources and
+// fan-outs are sorted in runs on tmp_dir and merged into the wire arrays.
+class ExternalGraphBuilder
+{
+private:
+    const std::string filename, tmp_dir;
+    const size_t run_entries;
+    FILE *fp = nullptr;
+    std::unique_ptr<BinaryOutput> gates_out;
+    long off_src = 0, off_begin = 0, off_dests = 0;
+
+    // wire << 32 | gate << 1 | (1 for a fan-out, 0 for the source)
+    std::vector<uint64_t> pairs;
+    std::vector<FILE *> runs;
+
+    int n_gate = 0, n_wire = 0, n_input = 0, n_output = 0, n_added = 0;
+    long n_dest = 0;
+
+    void spill();
+
+public:
+    ExternalGraphBuilder(const std::string &_filename,
+                         const std::string &_tmp_dir,
+                         const size_t memory_bytes);
+    ~ExternalGraphBuilder();
+    ExternalGraphBuilder(const ExternalGraphBuilder &) = delete;
+    ExternalGraphBuilder &operator=(const ExternalGraphBuilder &) = delete;
+
+    // the sizes of the Bristol header (wires.size() is n_wire + 1, as in
+    // CircuitGraph)
+    void begin(const int _n_gate, const int _n_wire, const int _n_input,
+               const int _n_output);
+    // the next gate, as read by CircuitGraph
+    void addGate(const Gate &g);
+    void finish();
+};
+
+// Read-only view of a graph in a binary circuit file (see CircuitCache.hpp)
+// through a memory mapping. Gates, sources and fan-outs are read in place
+// from contiguous arrays and paged in on demand, so the graph does not have
+// to fit in memory. Offers the accessors of CircuitGraph used by
+// CircuitGraph::reduceSize(graph) and RelinearizeCutSolver; only the graph
+// is out-of-core: both still allocate working arrays of O(n_gate) entries,
+// and the solver its whole flow network.
+class ExternalGraph
+{
+private:
+    MappedFile file;
+    const int32_t *gates_, *src_, *dest_begin_, *dests_;
+
+public:
+    int n_gate;
+    int n_wire;
+    int n_input;
+    int n_output;
+
+    // graph index of the file (0: the circuit, 1: its reduced graph for
+    // files of CircuitCache::load)
+    ExternalGraph(const std::string &filename, const int index = 0);
+
+    // out-of-core construction of graph_filename from a Bristol circuit
+    // (plain or compressed)
+    static void build(const std::string &circuit_filename,
+                      const std::string &graph_filename,
+                      const std::string &tmp_dir = "/tmp",
+                      const size_t memory_bytes = 1UL << 30);
+
+    Gate gate(const int i) const
+    {
+        const int32_t *g = gates_ + 4L * i;
+        return Gate(g[0], g[1], g[2], (gate_type)g[3]);
+    }
+    gate_type type(const int i) const
+    {
+        return (gate_type)gates_[4L * i + 3];
+    }
+    int src(const int w) const
+    {
+        return src_[w];
+    }
+    IndexRange dests(const int w) const
+    {
+        return IndexRange(dests_ + dest_begin_[w], dests_ + dest_begin_[w + 1]);
+    }
+};
+
+#endif // _FHE_EXTERNAL_GRAPH
@@ -0,0 +1,85 @@
+#ifndef _FHE_MAPPED_FILE
+#define _FHE_MAPPED_FILE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// Read-only memory mapping of a whole file (RAII)
+class MappedFile
+{
+private:
+    int fd = -1;
+    const char *addr = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile(const std::string &filename)
+    {
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open " + filename);
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("cannot stat " + filename);
+        }
+        length = st.st_size;
+        if (length == 0)
+            return; // mmap rejects empty mappings
+        void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("cannot mmap " + filename);
+        }
+        addr = static_cast<const char *>(p);
+    }
+    ~MappedFile()
+    {
+        if (addr != nullptr)
+            munmap(const_cast<char *>(addr), length);
+        if (fd >= 0)
+            close(fd);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // hint the kernel to read ahead aggressively
+    void adviseSequential() const
+    {
+        if (addr != nullptr)
+            madvise(const_cast<char *>(addr), length, MADV_SEQUENTIAL);
+    }
+
+    // drop the pages before upto once they have been consumed, so that a
+    // streaming reader does not keep the whole file resident
+    void release(const char *upto) const
+    {
+        const long page = sysconf(_SC_PAGESIZE);
+        size_t n = (upto - addr) / page * page;
+        if (addr != nullptr && n > 0)
+            madvise(const_cast<char *>(addr), n, MADV_DONTNEED);
+    }
+
+    const char *begin() const
+    {
+        return addr;
+    }
+    const char *end() const
+    {
+        return addr + length;
+    }
+    size_t size() const
+    {
+        return length;
+    }
+};
+
+#endif // _FHE_MAPPED_FILE
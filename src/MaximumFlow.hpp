@@ -2,11 +2,85 @@
 #define _FHE_MAX_FLOW
 
 #include <algorithm>
-#include <queue>
+#include <atomic>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "Parallel.hpp"
+
 const int INF = 1 << 30;
 
+// algorithm of MaximumFlow::max_flow (the same value with any)
+enum flow_engine
+{
+    FLOW_DINIC,             // Dinic's algorithm
+    FLOW_PUSH_RELABEL,      // highest-label push-relabel, with global
+                            // relabeling and the gap heuristic
+    FLOW_BOYKOV_KOLMOGOROV, // Boykov-Kolmogorov (two search trees reused)
+    FLOW_PSEUDOFLOW         // Hochbaum's pseudoflow, highest label first
+};
+
+// the engines by the name given on command lines, Dinic first
+inline std::vector<std::pair<std::string, flow_engine>> flowEngines()
+{
+    return {{"dinic", FLOW_DINIC},
+            {"push-relabel", FLOW_PUSH_RELABEL},
+            {"bk", FLOW_BOYKOV_KOLMOGOROV},
+            {"pseudoflow", FLOW_PSEUDOFLOW}};
+}
+
+// Maximum flow by Dinic's algorithm, push-relabel, Boykov-Kolmogorov or
+// pseudoflow (flow_engine).
+//
+// add_edge only collects the edges; the first max_flow freezes them into
+// one CSR array (the edges leaving v, each with the index of its reverse,
+// are contiguous), which the algorithms scan, so no edge is added after.
+//
+// The blocking flow of each phase of Dinic is found with an explicit stack
+// (the current path from s) instead of recursion, so the depth of the
+// network (e.g. of the circuit in RelinearizeCutSolver) is not limited by
+// the call stack.
+//
+// Push-relabel only runs its first phase, which leaves a maximum preflow:
+// the excess reaching t is the value of the maximum flow (and of the
+// minimum cut), though the flow on the edges is not a flow. Active
+// vertices are taken by highest label. The labels are set again to the
+// distances to t in the residual graph (global relabeling) at the start and
+// whenever the relabels have scanned about as many edges as the network
+// has; when no vertex is left at a label, those above it cannot reach t
+// and are dropped (gap heuristic).
+//
+// Boykov-Kolmogorov grows a search tree from s and one from t until they
+// meet, augments along the path found and keeps the trees, finding the
+// vertices cut off a new parent in their tree (adoption) or freeing them.
+// The distances to the roots, stamped with the time of the augmentation,
+// pick short paths (as in Kolmogorov's implementation).
+//
+// Pseudoflow (Hochbaum, as in the highest label variant of hpf) saturates
+// the edges from s and into t and keeps a forest whose roots hold the
+// excess: a tree is strong if it is positive. The strong root of highest
+// label l looks, in its tree from the root down through the vertices of
+// label l, for an edge to a vertex of label l - 1; the tree is then hung
+// from that vertex and its excess pushed to the root of the other tree,
+// splitting off below the edges saturated; otherwise the vertices are
+// relabeled. When no vertex has label l - 1, the strong trees of label l
+// get n (gap). Only this phase is run: the vertices of label n (and s) are
+// the source side of a minimum cut.
+//
+// Given more than one thread, push-relabel solves a network of
+// PARALLEL_VERTICES vertices or more on those threads (the other engines
+// are sequential whatever the threads). It runs in synchronous rounds over
+// the active vertices: first each pushes along the edges admissible for the
+// labels of the round (the excess received is added up atomically and kept
+// apart), then each with excess left is relabeled from those labels, and the
+// new labels and excesses take effect together. Two vertices never push
+// along the same pair of edges in a round (that would need each label one
+// above the other), so the capacities are not shared, and labels only grow,
+// so relabels done together keep the labeling valid. The global relabeling,
+// triggered as above, is a BFS whose levels are split over the threads.
 template <typename T>
 class MaximumFlow
 {
@@ -15,62 +89,148 @@ private:
     {
         int to;
         T cap;
-        int rev;
+        int rev; // index in edges
+    };
+    struct arc
+    {
+        int from, to;
+        T cap;
     };
-    std::vector<std::vector<edge>> Graph;
+    // the edges leaving v are edges[first[v] .. first[v + 1]); the arcs
+    // added and not frozen yet
+    int n_vertex;
+    std::vector<edge> edges;
+    std::vector<int> first;
+    std::vector<arc> arcs;
     std::vector<int> level, iter; // sからの距離,どこまで調べたか
+    std::vector<int> que, path;   // BFS queue, vertices of the current path
+    flow_engine engine;
+
+    // push-relabel: excess of each vertex; the vertices of each label in a
+    // doubly linked list (all_*), and the active ones (excess > 0) in a
+    // stack per label (active_*)
+    std::vector<T> excess;
+    std::vector<int> all_head, all_next, all_prev;
+    std::vector<int> active_head, active_next;
+    int max_label, max_active;
+
+    static const int PARALLEL_VERTICES = 1 << 16;
+    int num_threads;
+    size_t parallel_bytes = 0; // arrays of the last parallel run
+
+    // the edges leaving v, for range-based for
+    struct edge_range
+    {
+        edge *b, *e;
+        edge *begin() const
+        {
+            return b;
+        }
+        edge *end() const
+        {
+            return e;
+        }
+    };
+    edge_range adj(int v)
+    {
+        return {edges.data() + first[v], edges.data() + first[v + 1]};
+    }
+
+    void freeze()
+    {
+        if (!first.empty())
+            return;
+        if (arcs.size() > INT_MAX / 2)
+            throw std::length_error("too many edges for MaximumFlow");
+        first.assign(n_vertex + 1, 0);
+        for (const arc &a : arcs)
+        {
+            first[a.from + 1]++;
+            first[a.to + 1]++;
+        }
+        for (int v = 0; v < n_vertex; v++)
+            first[v + 1] += first[v];
+        // each vertex keeps the order in which its edges were added
+        iter.assign(std::begin(first), std::end(first) - 1);
+        edges.resize(2 * arcs.size());
+        for (const arc &a : arcs)
+        {
+            const int i = iter[a.from]++, j = iter[a.to]++;
+            edges[i] = {a.to, a.cap, j};
+            edges[j] = {a.from, 0, i};
+        }
+        std::vector<arc>().swap(arcs);
+    }
 
     void bfs(int s)
     {
         std::fill(std::begin(level), std::end(level), -1);
-        std::queue<int> q;
+        que.clear();
         level[s] = 0;
-        q.push(s);
-        while (!q.empty())
+        que.push_back(s);
+        for (size_t head = 0; head < que.size(); head++)
         {
-            int v = q.front();
-            q.pop();
-            for (auto e : Graph[v])
+            const int v = que[head];
+            for (const edge &e : adj(v))
             {
                 if (e.cap > 0 && level[e.to] < 0)
                 {
                     level[e.to] = level[v] + 1;
-                    q.push(e.to);
+                    que.push_back(e.to);
                 }
             }
         }
     }
 
-    T dfs(int v, int t, T f)
+    // augments along paths of the level graph until t cannot be reached;
+    // the edge leaving path[k] on the path is edges[iter[path[k]]]
+    T blockingFlow(int s, int t)
     {
-        if (v == t)
-            return f;
-        for (int &i = iter[v]; i < (int)Graph[v].size(); i++)
+        T flow = 0;
+        path.assign(1, s);
+        while (!path.empty())
         {
-            auto &e = Graph[v][i];
-            if (e.cap > 0 && level[v] < level[e.to])
+            const int v = path.back();
+            if (v == t)
             {
-                T d = dfs(e.to, t, std::min(f, e.cap));
-                if (d > 0)
+                T f = INF;
+                for (size_t k = 0; k + 1 < path.size(); k++)
+                    f = std::min(f, edges[iter[path[k]]].cap);
+                // back to the tail of the first edge saturated
+                size_t keep = path.size() - 1;
+                for (size_t k = 0; k + 1 < path.size(); k++)
                 {
-                    e.cap -= d;
-                    Graph[e.to][e.rev].cap += d;
-                    return d;
+                    edge &e = edges[iter[path[k]]];
+                    e.cap -= f;
+                    edges[e.rev].cap += f;
+                    if (e.cap == 0 && k < keep)
+                        keep = k;
                 }
+                path.resize(keep + 1);
+                flow += f;
+                continue;
             }
-        }
-        return 0;
-    }
 
-public:
-    MaximumFlow(int n)
-    {
-        Graph = std::vector<std::vector<edge>>(n);
-        level = std::vector<int>(n);
-        iter = std::vector<int>(n);
+            int &i = iter[v];
+            while (i < first[v + 1] &&
+                   !(edges[i].cap > 0 && level[edges[i].to] == level[v] + 1))
+                i++;
+            if (i < first[v + 1])
+            {
+                path.push_back(edges[i].to);
+            }
+            else
+            {
+                // no way to t from v in this phase
+                path.pop_back();
+                if (!path.empty())
+                    iter[path.back()]++;
+            }
+        }
+        return flow;
     }
 
-    T max_flow(int s, int t)
+    T dinic(int s, int t)
     {
         T flow = 0;
         while (true)
@@ -78,21 +238,896 @@ public:
             bfs(s);
             if (level[t] < 0)
                 break;
-            std::fill(std::begin(iter), std::end(iter), 0);
-            T f;
-            while ((f = dfs(s, t, INF)) > 0)
+            std::copy(std::begin(first), std::end(first) - 1, std::begin(iter));
+            flow += blockingFlow(s, t);
+        }
+        return flow;
+    }
+
+    // level doubles as the label; n (the number of vertices) for s and for
+    // the vertices that cannot reach t
+    void addLabeled(int v)
+    {
+        const int h = level[v];
+        all_prev[v] = -1;
+        all_next[v] = all_head[h];
+        if (all_head[h] != -1)
+            all_prev[all_head[h]] = v;
+        all_head[h] = v;
+        max_label = std::max(max_label, h);
+    }
+    void removeLabeled(int v)
+    {
+        if (all_prev[v] != -1)
+            all_next[all_prev[v]] = all_next[v];
+        else
+            all_head[level[v]] = all_next[v];
+        if (all_next[v] != -1)
+            all_prev[all_next[v]] = all_prev[v];
+    }
+    void addActive(int v)
+    {
+        const int h = level[v];
+        active_next[v] = active_head[h];
+        active_head[h] = v;
+        max_active = std::max(max_active, h);
+    }
+
+    // labels from a BFS from t over the residual edges, and the lists again
+    void globalRelabel(int s, int t)
+    {
+        const int n = n_vertex;
+        std::fill(std::begin(level), std::end(level), n);
+        std::fill(std::begin(all_head), std::end(all_head), -1);
+        std::fill(std::begin(active_head), std::end(active_head), -1);
+        max_label = max_active = 0;
+        que.clear();
+        level[t] = 0;
+        que.push_back(t);
+        for (size_t head = 0; head < que.size(); head++)
+        {
+            const int v = que[head];
+            addLabeled(v);
+            if (v != t && excess[v] > 0)
+                addActive(v);
+            for (const edge &e : adj(v))
             {
-                flow += f;
+                // e.to -> v has residual capacity
+                if (level[e.to] == n && e.to != s && edges[e.rev].cap > 0)
+                {
+                    level[e.to] = level[v] + 1;
+                    que.push_back(e.to);
+                }
+            }
+        }
+        std::copy(std::begin(first), std::end(first) - 1, std::begin(iter));
+    }
+
+    T pushRelabel(int s, int t)
+    {
+        const int n = n_vertex;
+        excess.assign(n, 0);
+        all_head.assign(n, -1);
+        all_next.assign(n, -1);
+        all_prev.assign(n, -1);
+        active_head.assign(n, -1);
+        active_next.assign(n, -1);
+
+        for (edge &e : adj(s))
+        {
+            excess[e.to] += e.cap;
+            edges[e.rev].cap += e.cap;
+            e.cap = 0;
+        }
+        globalRelabel(s, t);
+
+        const long m = edges.size();
+        long work = 0; // edges scanned by relabels since the global one
+        while (max_active >= 0)
+        {
+            const int v = active_head[max_active];
+            if (v == -1)
+            {
+                max_active--;
+                continue;
+            }
+            active_head[max_active] = active_next[v];
+            if (level[v] != max_active) // dropped by a gap
+                continue;
+
+            // discharge v
+            while (excess[v] > 0 && level[v] < n)
+            {
+                int &i = iter[v];
+                for (; i < first[v + 1] && excess[v] > 0; i++)
+                {
+                    edge &e = edges[i];
+                    if (e.cap > 0 && level[v] == level[e.to] + 1)
+                    {
+                        const T d = std::min(excess[v], e.cap);
+                        e.cap -= d;
+                        edges[e.rev].cap += d;
+                        if (excess[e.to] == 0 && e.to != t)
+                            addActive(e.to);
+                        excess[e.to] += d;
+                        excess[v] -= d;
+                        if (excess[v] == 0)
+                            break;
+                    }
+                }
+                if (excess[v] == 0)
+                    break;
+
+                // relabel
+                const int old = level[v];
+                int h = n;
+                for (const edge &e : adj(v))
+                    if (e.cap > 0)
+                        h = std::min(h, level[e.to] + 1);
+                work += first[v + 1] - first[v] + 12;
+                removeLabeled(v);
+                if (all_head[old] == -1)
+                {
+                    // gap: nothing above old reaches t any more
+                    for (int k = old + 1; k <= max_label; k++)
+                    {
+                        for (int u = all_head[k]; u != -1; u = all_next[u])
+                            level[u] = n;
+                        all_head[k] = -1;
+                    }
+                    max_label = old - 1;
+                    level[v] = n;
+                    break;
+                }
+                level[v] = std::min(h, n);
+                i = first[v];
+                if (level[v] >= n)
+                    break;
+                addLabeled(v);
+            }
+
+            if (work > m + n)
+            {
+                globalRelabel(s, t);
+                work = 0;
+            }
+        }
+        return excess[t];
+    }
+
+    T parallelPushRelabel(int s, int t)
+    {
+        const int n = n_vertex;
+        const int nt = num_threads;
+        const auto relaxed = std::memory_order_relaxed;
+        std::vector<std::atomic<int>> label(n);
+        std::vector<int> new_label(n);
+        // excess received in the round, and whether the vertex is in next
+        std::vector<std::atomic<T>> added(n);
+        std::vector<std::atomic<char>> in_next(n);
+
+        excess.assign(n, 0);
+        for (edge &e : adj(s))
+        {
+            excess[e.to] += e.cap;
+            edges[e.rev].cap += e.cap;
+            e.cap = 0;
+        }
+        const long m = edges.size();
+
+        // a set of vertices is a list per thread: list l at [offset[l],
+        // offset[l + 1]) of their concatenation. cur holds the active
+        // vertices of the round, next those of the next one (each once), and
+        // front, front_next the levels of the global relabeling
+        std::vector<std::vector<int>> cur(nt), next(nt), front(nt),
+          front_next(nt);
+        std::vector<long> offset(nt + 1, 0);
+        std::atomic<long> pos[3];
+        std::atomic<long> work(0); // edges scanned by relabels
+        bool global = true, done = false;
+        Barrier barrier(nt);
+
+        // set by one thread between barriers
+        auto setOffsets = [&](const std::vector<std::vector<int>> &lists)
+        {
+            for (int l = 0; l < nt; l++)
+                offset[l + 1] = offset[l] + lists[l].size();
+            for (auto &p : pos)
+                p = 0;
+        };
+        // fn(v) for each v of lists, the threads taking CHUNK at a time
+        const long CHUNK = 64;
+        auto forEach = [&](const std::vector<std::vector<int>> &lists,
+                           std::atomic<long> &p, auto fn)
+        {
+            const long total = offset[nt];
+            for (long b = p.fetch_add(CHUNK); b < total; b = p.fetch_add(CHUNK))
+            {
+                int l = std::upper_bound(std::begin(offset), std::end(offset),
+                                         b) -
+                        std::begin(offset) - 1;
+                for (long k = b; k < std::min(total, b + CHUNK); k++)
+                {
+                    while (k >= offset[l + 1])
+                        l++;
+                    fn(lists[l][k - offset[l]]);
+                }
+            }
+        };
+
+        // the global relabeling labels depth the vertices (not labeled yet)
+        // with a residual edge to one of front, and puts them in a list of
+        // front_next; a level of less than PARALLEL_LEVEL vertices is done
+        // by one thread (in serialLevels), as a deep network has many
+        int depth = 0;
+        auto visit = [&](const int v, std::vector<int> &found)
+        {
+            for (const edge &e : adj(v))
+            {
+                // e.to -> v has residual capacity
+                int unset = n;
+                if (e.to != s && edges[e.rev].cap > 0 &&
+                    label[e.to].load(relaxed) == n &&
+                    label[e.to].compare_exchange_strong(unset, depth, relaxed))
+                    found.push_back(e.to);
+            }
+        };
+        const long PARALLEL_LEVEL = 4096;
+        auto serialLevels = [&]()
+        {
+            for (auto &f : front_next)
+                f.clear();
+            setOffsets(front);
+            while (offset[nt] > 0 && offset[nt] < PARALLEL_LEVEL)
+            {
+                for (const auto &f : front)
+                    for (const int v : f)
+                        visit(v, front_next[0]);
+                std::swap(front, front_next);
+                for (auto &f : front_next)
+                    f.clear();
+                setOffsets(front);
+                depth++;
+            }
+        };
+
+        auto worker = [&](const int tid, long, long)
+        {
+            const int block_begin = (long)n * tid / nt;
+            const int block_end = (long)n * (tid + 1) / nt;
+            while (true)
+            {
+                if (global)
+                {
+                    for (int v = block_begin; v < block_end; v++)
+                        label[v].store(v == t ? 0 : n, relaxed);
+                    barrier.wait();
+                    if (tid == 0)
+                    {
+                        front[0].assign(1, t);
+                        depth = 1;
+                        serialLevels();
+                    }
+                    barrier.wait();
+                    while (offset[nt] > 0)
+                    {
+                        forEach(front, pos[0], [&](const int v)
+                                { visit(v, front_next[tid]); });
+                        barrier.wait();
+                        if (tid == 0)
+                        {
+                            std::swap(front, front_next);
+                            depth++;
+                            serialLevels();
+                        }
+                        barrier.wait();
+                    }
+                    cur[tid].clear();
+                    for (int v = block_begin; v < block_end; v++)
+                        if (v != s && v != t && excess[v] > 0 &&
+                            label[v].load(relaxed) < n)
+                            cur[tid].push_back(v);
+                    barrier.wait();
+                    if (tid == 0)
+                    {
+                        setOffsets(cur);
+                        work = 0;
+                        global = false;
+                        done = (offset[nt] == 0);
+                    }
+                    barrier.wait();
+                }
+                if (done)
+                    break;
+
+                // push along the admissible edges
+                auto receive = [&](const int v, const T d)
+                {
+                    if (added[v].fetch_add(d, relaxed) == 0 && v != t &&
+                        !in_next[v].exchange(1, relaxed))
+                        next[tid].push_back(v);
+                };
+                forEach(cur, pos[0], [&](const int v) {
+                    const int h = label[v].load(relaxed);
+                    if (h >= n)
+                        return;
+                    T ex = excess[v];
+                    for (edge &e : adj(v))
+                    {
+                        // the label first: e may be written by e.to otherwise
+                        if (label[e.to].load(relaxed) + 1 == h && e.cap > 0)
+                        {
+                            const T d = std::min(ex, e.cap);
+                            e.cap -= d;
+                            edges[e.rev].cap += d;
+                            ex -= d;
+                            receive(e.to, d);
+                            if (ex == 0)
+                                break;
+                        }
+                    }
+                    excess[v] = ex;
+                });
+                barrier.wait();
+
+                // relabel the vertices with excess left
+                long scanned = 0;
+                forEach(cur, pos[1], [&](const int v) {
+                    int h = label[v].load(relaxed);
+                    if (excess[v] > 0 && h < n)
+                    {
+                        h = n;
+                        for (const edge &e : adj(v))
+                            if (e.cap > 0)
+                                h = std::min(h, label[e.to].load(relaxed) + 1);
+                        scanned += first[v + 1] - first[v] + 12;
+                        if (h < n && !in_next[v].exchange(1, relaxed))
+                            next[tid].push_back(v);
+                    }
+                    new_label[v] = h;
+                });
+                work += scanned;
+                barrier.wait();
+
+                forEach(cur, pos[2], [&](const int v) {
+                    label[v].store(new_label[v], relaxed);
+                });
+                for (const int v : next[tid])
+                {
+                    excess[v] += added[v].exchange(0, relaxed);
+                    in_next[v].store(0, relaxed);
+                }
+                barrier.wait();
+                if (tid == 0)
+                {
+                    std::swap(cur, next);
+                    for (auto &l : next)
+                        l.clear();
+                    setOffsets(cur);
+                    done = (offset[nt] == 0);
+                    global = !done && work > m + n;
+                }
+                barrier.wait();
+            }
+        };
+        parallelFor(nt, nt, worker);
+
+        parallel_bytes = n * (sizeof(std::atomic<int>) + sizeof(int) +
+                              sizeof(std::atomic<T>) +
+                              sizeof(std::atomic<char>));
+        for (const auto *lists : {&cur, &next, &front, &front_next})
+            for (const auto &l : *lists)
+                parallel_bytes += l.capacity() * sizeof(int);
+        return excess[t] + added[t].load();
+    }
+
+    // Boykov-Kolmogorov: a search tree grown from s and one from t (tree,
+    // FREE if in none), up the edge to the parent (from the vertex), the
+    // FIFO queue of active vertices in que from que_head (queued), and the
+    // orphans; level doubles as the distance to the root, valid if the
+    // stamp is the time of the last adoption
+    enum
+    {
+        FREE,
+        S_TREE,
+        T_TREE
+    };
+    static const int ROOT = -2, ORPHAN = -3;
+    std::vector<char> tree, queued;
+    std::vector<int> up, stamp, orphans;
+    size_t que_head;
+
+    // the residual capacity into the tree (from v's parent in the S tree,
+    // to it in the T tree) of the edge i leaving v
+    T treeCap(char x, int i) const
+    {
+        return x == S_TREE ? edges[edges[i].rev].cap : edges[i].cap;
+    }
+    void enqueue(int v)
+    {
+        if (!queued[v])
+        {
+            queued[v] = 1;
+            que.push_back(v);
+        }
+    }
+
+    // the edge from the S tree to the T tree found by growing the trees
+    // from the active vertices, -1 if none
+    int grow()
+    {
+        if (que_head > 4096 && 2 * que_head > que.size())
+        {
+            que.erase(std::begin(que), std::begin(que) + que_head);
+            que_head = 0;
+        }
+        for (; que_head < que.size(); que_head++)
+        {
+            const int v = que[que_head];
+            if (tree[v] != FREE)
+            {
+                for (int i = first[v]; i < first[v + 1]; i++)
+                {
+                    const edge &e = edges[i];
+                    if ((tree[v] == S_TREE ? e.cap : edges[e.rev].cap) == 0)
+                        continue;
+                    const int w = e.to;
+                    if (tree[w] == FREE)
+                    {
+                        tree[w] = tree[v];
+                        up[w] = e.rev;
+                        level[w] = level[v] + 1;
+                        stamp[w] = stamp[v];
+                        enqueue(w);
+                    }
+                    else if (tree[w] != tree[v])
+                    {
+                        // v stays active (at the head)
+                        return tree[v] == S_TREE ? i : e.rev;
+                    }
+                    else if (stamp[w] <= stamp[v] && level[w] > level[v])
+                    {
+                        // a shorter path to the root through v
+                        up[w] = e.rev;
+                        level[w] = level[v] + 1;
+                        stamp[w] = stamp[v];
+                    }
+                }
+            }
+            queued[v] = 0;
+        }
+        return -1;
+    }
+
+    // pushes the bottleneck of the path through the edge i from the S tree
+    // to the T tree; the vertices below a saturated tree edge are orphans
+    T augment(int s, int t, int i)
+    {
+        T f = edges[i].cap;
+        for (int v = edges[edges[i].rev].to; v != s; v = edges[up[v]].to)
+            f = std::min(f, edges[edges[up[v]].rev].cap);
+        for (int v = edges[i].to; v != t; v = edges[up[v]].to)
+            f = std::min(f, edges[up[v]].cap);
+
+        edges[i].cap -= f;
+        edges[edges[i].rev].cap += f;
+        for (int v = edges[edges[i].rev].to; v != s;)
+        {
+            edge &e = edges[up[v]];
+            const int p = e.to;
+            e.cap += f;
+            edges[e.rev].cap -= f;
+            if (edges[e.rev].cap == 0)
+            {
+                up[v] = ORPHAN;
+                orphans.push_back(v);
+            }
+            v = p;
+        }
+        for (int v = edges[i].to; v != t;)
+        {
+            edge &e = edges[up[v]];
+            const int p = e.to;
+            e.cap -= f;
+            edges[e.rev].cap += f;
+            if (e.cap == 0)
+            {
+                up[v] = ORPHAN;
+                orphans.push_back(v);
+            }
+            v = p;
+        }
+        return f;
+    }
+
+    // finds each orphan a new parent in its tree, one whose path goes to the
+    // root (the shortest known), or frees it and makes its children orphans
+    void adopt(int time)
+    {
+        while (!orphans.empty())
+        {
+            const int v = orphans.back();
+            orphans.pop_back();
+            const char x = tree[v];
+            int best = -1, best_dist = INT_MAX;
+            for (int i = first[v]; i < first[v + 1]; i++)
+            {
+                const int w = edges[i].to;
+                if (tree[w] != x || treeCap(x, i) == 0)
+                    continue;
+                int d = 0, j = w;
+                while (stamp[j] != time)
+                {
+                    if (up[j] == ROOT)
+                    {
+                        stamp[j] = time;
+                        level[j] = 0;
+                        break;
+                    }
+                    if (up[j] == ORPHAN)
+                    {
+                        d = INT_MAX;
+                        break;
+                    }
+                    d++;
+                    j = edges[up[j]].to;
+                }
+                if (d == INT_MAX)
+                    continue;
+                d += level[j];
+                if (d < best_dist)
+                {
+                    best = i;
+                    best_dist = d;
+                }
+                for (j = w; stamp[j] != time; j = edges[up[j]].to)
+                {
+                    stamp[j] = time;
+                    level[j] = d--;
+                }
+            }
+            if (best != -1)
+            {
+                up[v] = best;
+                stamp[v] = time;
+                level[v] = best_dist + 1;
+                continue;
+            }
+
+            for (int i = first[v]; i < first[v + 1]; i++)
+            {
+                const int w = edges[i].to;
+                if (tree[w] != x)
+                    continue;
+                if (treeCap(x, i) > 0)
+                    enqueue(w);
+                if (up[w] >= 0 && edges[up[w]].to == v)
+                {
+                    up[w] = ORPHAN;
+                    orphans.push_back(w);
+                }
             }
+            tree[v] = FREE;
+        }
+    }
+
+    T boykovKolmogorov(int s, int t)
+    {
+        const int n = n_vertex;
+        tree.assign(n, FREE);
+        queued.assign(n, 0);
+        up.assign(n, -1);
+        stamp.assign(n, 0);
+        std::fill(std::begin(level), std::end(level), 0);
+        tree[s] = S_TREE;
+        tree[t] = T_TREE;
+        up[s] = up[t] = ROOT;
+        que.clear();
+        que_head = 0;
+        enqueue(s);
+        enqueue(t);
+
+        T flow = 0;
+        for (int time = 1;; time++)
+        {
+            const int i = grow();
+            if (i == -1)
+                break;
+            flow += augment(s, t, i);
+            adopt(time);
         }
         return flow;
     }
 
+    // pseudoflow: the trees of the normalized forest by parent (-1 at a
+    // root), up (the edge to the parent) and the children in a doubly linked
+    // list; excess is held by the roots, which are strong if it is positive.
+    // The strong roots are in active_* as the active vertices of
+    // push-relabel, level is the label, counted in label_count, iter the
+    // next edge to look at for a merger and scan the next child
+    std::vector<int> parent, child_head, sibling_next, sibling_prev, scan;
+    std::vector<int> label_count;
+
+    void addChild(int p, int c)
+    {
+        parent[c] = p;
+        sibling_prev[c] = -1;
+        sibling_next[c] = child_head[p];
+        if (child_head[p] != -1)
+            sibling_prev[child_head[p]] = c;
+        child_head[p] = c;
+    }
+    void removeChild(int p, int c)
+    {
+        if (scan[p] == c)
+            scan[p] = sibling_next[c];
+        if (sibling_prev[c] != -1)
+            sibling_next[sibling_prev[c]] = sibling_next[c];
+        else
+            child_head[p] = sibling_next[c];
+        if (sibling_next[c] != -1)
+            sibling_prev[sibling_next[c]] = sibling_prev[c];
+        parent[c] = -1;
+    }
+    void setLabel(int v, int h)
+    {
+        label_count[level[v]]--;
+        level[v] = h;
+        label_count[h]++;
+    }
+
+    // relabels v unless a child not scanned yet has its label
+    void checkChildren(int v)
+    {
+        for (; scan[v] != -1; scan[v] = sibling_next[scan[v]])
+            if (level[scan[v]] == level[v])
+                return;
+        setLabel(v, level[v] + 1);
+        iter[v] = first[v];
+    }
+
+    // the edge from v to a vertex one label lower (a weak one, for v in the
+    // strong tree of highest label), -1 if none
+    int findMerger(int v)
+    {
+        for (int &i = iter[v]; i < first[v + 1]; i++)
+            if (edges[i].cap > 0 && level[edges[i].to] == level[v] - 1)
+                return iter[v];
+        return -1;
+    }
+
+    // hangs the tree of r from the other end of the edge i leaving v (a
+    // vertex of the tree, which becomes its root on the way) and pushes the
+    // excess of r up to the new root; where an edge is too small, the
+    // subtree below it is split off as a strong tree
+    void merge(int r, int v, int i)
+    {
+        const int n = n_vertex;
+        int cur = v, new_parent = edges[i].to, new_up = i;
+        while (parent[cur] != -1)
+        {
+            const int p = parent[cur], old_up = up[cur];
+            removeChild(p, cur);
+            addChild(new_parent, cur);
+            up[cur] = new_up;
+            new_parent = cur;
+            new_up = edges[old_up].rev;
+            cur = p;
+        }
+        addChild(new_parent, cur);
+        up[cur] = new_up;
+
+        T before = 1;
+        for (cur = r; excess[cur] > 0 && parent[cur] != -1;)
+        {
+            const int p = parent[cur];
+            edge &e = edges[up[cur]];
+            const T d = std::min(e.cap, excess[cur]);
+            before = excess[p];
+            e.cap -= d;
+            edges[e.rev].cap += d;
+            excess[p] += d;
+            excess[cur] -= d;
+            if (excess[cur] > 0)
+            {
+                // p -> cur is out of the tree with capacity left
+                iter[p] = std::min(iter[p], e.rev);
+                removeChild(p, cur);
+                if (level[cur] < n)
+                    addActive(cur);
+            }
+            cur = p;
+        }
+        if (excess[cur] > 0 && before <= 0 && level[cur] < n)
+            addActive(cur);
+    }
+
+    // tries a merger from the vertices of the strong tree of r with its label
+    // (depth first), relabeling those of them left without one after their
+    // children with the label
+    void processRoot(int r)
+    {
+        int v = r;
+        scan[r] = child_head[r];
+        int i = findMerger(r);
+        if (i != -1)
+        {
+            merge(r, r, i);
+            return;
+        }
+        checkChildren(r);
+        while (v != -1)
+        {
+            while (scan[v] != -1)
+            {
+                const int c = scan[v];
+                scan[v] = sibling_next[c];
+                v = c;
+                scan[v] = child_head[v];
+                i = findMerger(v);
+                if (i != -1)
+                {
+                    merge(r, v, i);
+                    return;
+                }
+                checkChildren(v);
+            }
+            v = parent[v];
+            if (v != -1)
+                checkChildren(v);
+        }
+        if (level[r] < n_vertex)
+            addActive(r);
+    }
+
+    // labels n for the tree of r
+    void liftAll(int r)
+    {
+        int v = r;
+        setLabel(r, n_vertex);
+        scan[r] = child_head[r];
+        while (v != -1)
+        {
+            while (scan[v] != -1)
+            {
+                const int c = scan[v];
+                scan[v] = sibling_next[c];
+                v = c;
+                scan[v] = child_head[v];
+                setLabel(v, n_vertex);
+            }
+            v = v == r ? -1 : parent[v];
+        }
+    }
+
+    T pseudoflow(int s, int t)
+    {
+        const int n = n_vertex;
+        excess.assign(n, 0);
+        parent.assign(n, -1);
+        up.assign(n, -1);
+        child_head.assign(n, -1);
+        sibling_next.assign(n, -1);
+        sibling_prev.assign(n, -1);
+        scan.assign(n, -1);
+        active_head.assign(n + 1, -1);
+        active_next.assign(n, -1);
+        label_count.assign(n + 1, 0);
+        std::copy(std::begin(first), std::end(first) - 1, std::begin(iter));
+        max_active = 0;
+
+        // saturates the edges from s and those to t
+        T from_s = 0;
+        for (edge &e : adj(s))
+        {
+            if (e.to == s)
+                continue;
+            from_s += e.cap;
+            excess[e.to] += e.cap;
+            edges[e.rev].cap += e.cap;
+            e.cap = 0;
+        }
+        for (edge &e : adj(t))
+        {
+            if (e.to == t)
+                continue;
+            edge &r = edges[e.rev];
+            // a deficit of INF is more than any flow below INF can fill:
+            // deeper ones (parallel INF edges into t) would overflow T
+            excess[e.to] = std::max<T>(excess[e.to] - r.cap, -INF);
+            e.cap += r.cap;
+            r.cap = 0;
+        }
+        std::fill(std::begin(level), std::end(level), 1);
+        level[s] = n;
+        level[t] = 0;
+        for (int v = 0; v < n; v++)
+        {
+            label_count[level[v]]++;
+            if (v != s && v != t && excess[v] > 0)
+                addActive(v);
+        }
+
+        // the strong root of highest label below n, as long as one has a
+        // vertex one label lower (gap: none, and those roots get n)
+        while (max_active > 0)
+        {
+            const int r = active_head[max_active];
+            if (r == -1)
+            {
+                max_active--;
+                continue;
+            }
+            active_head[max_active] = active_next[r];
+            if (label_count[max_active - 1] == 0)
+                liftAll(r);
+            else
+                processRoot(r);
+        }
+
+        // the minimum cut is from the vertices of label n (and s), every
+        // edge out of it saturated and none into it used: what leaves s less
+        // what stays in it
+        T cut = from_s;
+        for (int v = 0; v < n; v++)
+            if (level[v] >= n && v != s)
+                cut -= excess[v];
+        return cut;
+    }
+
+public:
+    // max_threads as for resolveThreads (0: all cores)
+    MaximumFlow(int n, flow_engine _engine = FLOW_DINIC, int max_threads = 1)
+      : n_vertex(n), engine(_engine), num_threads(resolveThreads(max_threads))
+    {
+        level = std::vector<int>(n);
+        iter = std::vector<int>(n);
+    }
+
+    T max_flow(int s, int t)
+    {
+        freeze();
+        if (engine == FLOW_PUSH_RELABEL)
+        {
+            if (num_threads > 1 && n_vertex >= PARALLEL_VERTICES)
+                return parallelPushRelabel(s, t);
+            return pushRelabel(s, t);
+        }
+        if (engine == FLOW_BOYKOV_KOLMOGOROV)
+            return boykovKolmogorov(s, t);
+        if (engine == FLOW_PSEUDOFLOW)
+            return pseudoflow(s, t);
+        return dinic(s, t);
+    }
+
+    // room for m edges, to be added
+    void reserve(long m)
+    {
+        arcs.reserve(m);
+    }
+
+    // bytes taken by the network and by the arrays of the engine (after
+    // max_flow: those it ran with)
+    size_t memoryBytes() const
+    {
+        size_t bytes = edges.capacity() * sizeof(edge) +
+                       arcs.capacity() * sizeof(arc) +
+                       excess.capacity() * sizeof(T) + tree.capacity() +
+                       queued.capacity() + parallel_bytes;
+        for (const auto *v :
+             {&first, &level, &iter, &que, &path, &all_head, &all_next,
+              &all_prev, &active_head, &active_next, &up, &stamp, &orphans,
+              &parent, &child_head, &sibling_next, &sibling_prev, &scan,
+              &label_count})
+            bytes += v->capacity() * sizeof(int);
+        return bytes;
+    }
+
     void add_edge(int from, int to, T cap)
     {
-        int tos = Graph[to].size(), froms = Graph[from].size();
-        Graph[from].push_back(((edge){to, cap, tos}));
-        Graph[to].push_back(((edge){from, 0, froms}));
+        if (!first.empty())
+            throw std::logic_error("edge added to a frozen MaximumFlow");
+        arcs.push_back(((arc){from, to, cap}));
     }
 };
 
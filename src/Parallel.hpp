@@ -0,0 +1,105 @@
+#ifndef _FHE_PARALLEL
+#define _FHE_PARALLEL
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of worker threads to use; 0 means all cores (as for gurobi)
+inline int resolveThreads(const int max_threads)
+{
+    if (max_threads > 0)
+        return max_threads;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [0, n) into one contiguous block per thread and runs
+// fn(thread_id, begin, end) on each block. The calling thread runs block 0.
+template <class F>
+void parallelFor(const int num_threads, const long n, F fn)
+{
+    int nt = (int)std::max(1L, std::min<long>(num_threads, n));
+    std::vector<std::thread> workers;
+    for (int t = 1; t < nt; t++)
+    {
+        workers.emplace_back(fn, t, n * t / nt, n * (t + 1) / nt);
+    }
+    fn(0, 0L, n / nt);
+    for (auto &w : workers)
+        w.join();
+}
+
+// Runs fn(thread_id, k) for each k in [0, n) on num_threads threads, each
+// thread taking the next k as soon as it is done with the previous one (for
+// tasks of uneven size). The calling thread is thread 0. The first exception
+// thrown by fn is thrown here once the threads are done; the tasks not
+// started by then are skipped.
+template <class F>
+void parallelTasks(const int num_threads, const long n, F fn)
+{
+    int nt = (int)std::max(1L, std::min<long>(num_threads, n));
+    std::atomic<long> next(0);
+    std::mutex mtx;
+    std::exception_ptr error;
+    auto work = [&](const int t)
+    {
+        for (long k = next++; k < n; k = next++)
+        {
+            try
+            {
+                fn(t, k);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!error)
+                    error = std::current_exception();
+                next = n;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < nt; t++)
+        workers.emplace_back(work, t);
+    work(0);
+    for (auto &w : workers)
+        w.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// Lets num_threads threads wait for each other: wait() returns once all of
+// them have called it, after which the barrier can be used again (for the
+// rounds of an algorithm run by threads started once).
+class Barrier
+{
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    const int num_threads;
+    int waiting = 0;
+    long generation = 0;
+
+public:
+    explicit Barrier(const int _num_threads) : num_threads(_num_threads) {}
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        const long g = generation;
+        if (++waiting == num_threads)
+        {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return generation != g; });
+    }
+};
+
+#endif // _FHE_PARALLEL
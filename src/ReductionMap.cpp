@@ -0,0 +1,88 @@
+#include "ReductionMap.hpp"
+
+#include <utility>
+
+#include "ExternalGraph.hpp"
+
+// members[begin[r] .. begin[r + 1]) = the i with to[i] == r, increasing
+static void invert(const std::vector<int32_t> &to, const int n_reduced,
+                   std::vector<int32_t> &begin, std::vector<int32_t> &members)
+{
+    begin.assign(n_reduced + 1, 0);
+    for (const int r : to)
+        begin[r + 1]++;
+    for (int r = 0; r < n_reduced; r++)
+        begin[r + 1] += begin[r];
+    std::vector<int32_t> pos(begin.begin(), begin.end() - 1);
+    members.resize(to.size());
+    for (size_t i = 0; i < to.size(); i++)
+        members[pos[to[i]]++] = i;
+}
+
+template <class Graph>
+ReductionMap::ReductionMap(const Graph &graph, const CircuitGraph &reduced,
+                           std::vector<int32_t> num_v,
+                           std::vector<int32_t> num_e)
+  : gate_to(std::move(num_v)), wire_to(std::move(num_e))
+{
+    gate_to.resize(graph.n_gate);
+    wire_to.resize(graph.n_wire);
+    invert(gate_to, reduced.n_gate, gate_begin, gate_members);
+    invert(wire_to, reduced.n_wire, wire_begin, wire_members);
+
+    // the root of a reduced gate reads values of other reduced gates only;
+    // a reduced gate of an input wire has none, and takes its first gate
+    gate_rep.assign(reduced.n_gate, -1);
+    for (int i = 0; i < graph.n_gate; i++)
+    {
+        const Gate g = graph.gate(i);
+        const int v = gate_to[i];
+        if (g.type == AND || wire_to[g.in1] != reduced.gate(v).out)
+            gate_rep[v] = i;
+    }
+    for (int v = 0; v < reduced.n_gate; v++)
+        if (gate_rep[v] == -1)
+            gate_rep[v] = *gatesOf(v).begin();
+
+    wire_rep.resize(reduced.n_wire);
+    for (int e = 0; e < reduced.n_wire; e++)
+    {
+        const int v = reduced.src(e);
+        wire_rep[e] = (v == -1 ? e : graph.gate(gate_rep[v]).out);
+    }
+}
+
+std::vector<int>
+ReductionMap::liftGates(const std::vector<int> &reduced_gates) const
+{
+    std::vector<int> gates(reduced_gates.size());
+    for (size_t k = 0; k < reduced_gates.size(); k++)
+        gates[k] = gate_rep[reduced_gates[k]];
+    return gates;
+}
+
+std::vector<int>
+ReductionMap::liftWires(const std::vector<int> &reduced_wires) const
+{
+    std::vector<int> wires(reduced_wires.size());
+    for (size_t k = 0; k < reduced_wires.size(); k++)
+        wires[k] = wire_rep[reduced_wires[k]];
+    return wires;
+}
+
+size_t ReductionMap::memoryBytes() const
+{
+    return 4 * (gate_to.capacity() + wire_to.capacity() +
+                gate_rep.capacity() + wire_rep.capacity() +
+                gate_begin.capacity() + gate_members.capacity() +
+                wire_begin.capacity() + wire_members.capacity());
+}
+
+template ReductionMap::ReductionMap(const CircuitGraph &graph,
+                                    const CircuitGraph &reduced,
+                                    std::vector<int32_t> num_v,
+                                    std::vector<int32_t> num_e);
+template ReductionMap::ReductionMap(const ExternalGraph &graph,
+                                    const CircuitGraph &reduced,
+                                    std::vector<int32_t> num_v,
+                                    std::vector<int32_t> num_e);
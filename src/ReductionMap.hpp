@@ -0,0 +1,87 @@
+#ifndef _FHE_REDUCTION_MAP
+#define _FHE_REDUCTION_MAP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+
+// Correspondence between a circuit and the graph CircuitGraph::reduceSize
+// made of it, for carrying decisions taken on the reduced graph (gates to
+// bootstrap, wires to relinearize) back to the circuit.
+//
+// A reduced gate stands for the original gates merged into it: an AND gate,
+// or an XOR of two different values, with the XOR and INV gates that only
+// combine its output (its root first), or the gates that only combine an
+// input wire. A reduced wire stands for the outputs of those gates (or the
+// input wire). The representative of a reduced gate is its root, or the
+// first gate reading the input wire; the representative of a reduced wire is
+// the output of that gate, or the input wire itself. All lookups are O(1)
+// and lifting is linear in the number of decisions.
+class ReductionMap
+{
+private:
+    // original index -> reduced index
+    std::vector<int32_t> gate_to, wire_to;
+    // reduced index -> representative original index
+    std::vector<int32_t> gate_rep, wire_rep;
+    // reduced index -> original indices, in compressed sparse row form
+    std::vector<int32_t> gate_begin, gate_members;
+    std::vector<int32_t> wire_begin, wire_members;
+
+public:
+    ReductionMap(){};
+    // num_v / num_e: the reduced gate / wire of each gate / wire of graph
+    template <class Graph>
+    ReductionMap(const Graph &graph, const CircuitGraph &reduced,
+                 std::vector<int32_t> num_v, std::vector<int32_t> num_e);
+
+    int originalGates() const
+    {
+        return gate_to.size();
+    }
+    int reducedGates() const
+    {
+        return gate_rep.size();
+    }
+
+    // reduced gate (wire) of an original gate (wire)
+    int reducedGate(const int i) const
+    {
+        return gate_to[i];
+    }
+    int reducedWire(const int w) const
+    {
+        return wire_to[w];
+    }
+    // representative original gate (wire) of a reduced gate (wire)
+    int originalGate(const int v) const
+    {
+        return gate_rep[v];
+    }
+    int originalWire(const int e) const
+    {
+        return wire_rep[e];
+    }
+    // all original gates (wires) merged into a reduced gate (wire), in
+    // increasing order
+    IndexRange gatesOf(const int v) const
+    {
+        return IndexRange(gate_members.data() + gate_begin[v],
+                          gate_members.data() + gate_begin[v + 1]);
+    }
+    IndexRange wiresOf(const int e) const
+    {
+        return IndexRange(wire_members.data() + wire_begin[e],
+                          wire_members.data() + wire_begin[e + 1]);
+    }
+
+    // the representatives of reduced gates (wires), in the given order
+    std::vector<int> liftGates(const std::vector<int> &reduced_gates) const;
+    std::vector<int> liftWires(const std::vector<int> &reduced_wires) const;
+
+    size_t memoryBytes() const;
+};
+
+#endif // _FHE_REDUCTION_MAP
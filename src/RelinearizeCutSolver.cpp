@@ -6,16 +6,33 @@
 ProblemResult RelinearizeCutSolver::solve(const int kr, const int km,
                                           const CircuitGraph &graph,
                                           const int max_threads)
+{
+    return solveGraph(kr, km, graph, max_threads);
+}
+
+ProblemResult RelinearizeCutSolver::solve(const int kr, const int km,
+                                          const ExternalGraph &graph,
+                                          const int max_threads)
+{
+    return solveGraph(kr, km, graph, max_threads);
+}
+
+template <class Graph>
+ProblemResult RelinearizeCutSolver::solveGraph(const int kr, const int km,
+                                               const Graph &graph,
+                                               const int max_threads)
 {
     timer.set();
 
-    MaximumFlow<int> flow(2 * graph.n_gate + 2);
+    MaximumFlow<int> flow(2 * graph.n_gate + 2, engine, max_threads);
     int s = 2 * graph.n_gate, t = s + 1;
+    // a bound: one edge per gate, one per gate input, one per output
+    flow.reserve(3L * graph.n_gate + graph.n_output);
 
     count_and = 0;
     for (int i = 0; i < graph.n_gate; i++)
     {
-        if (graph.gates[i].type == AND)
+        if (graph.type(i) == AND)
         {
             flow.add_edge(s, 2 * i + 1, 1); // apply just after AND
             flow.add_edge(2 * i, t, 2);     // just befor AND, apply both inputs
@@ -29,21 +46,21 @@ ProblemResult RelinearizeCutSolver::solve(const int kr, const int km,
 
     for (int i = graph.n_input; i < graph.n_wire - graph.n_output; i++)
     {
-        auto e = graph.wires[i];
-        for (auto to : e.dests)
+        const int src = graph.src(i);
+        for (const int to : graph.dests(i))
         {
-            flow.add_edge(2 * e.src + 1, 2 * to, INF);
+            flow.add_edge(2 * src + 1, 2 * to, INF);
         }
     }
 
     // force every output to be back size 2
     for (int i = graph.n_wire - graph.n_output; i < graph.n_wire; i++)
     {
-        auto e = graph.wires[i];
-        flow.add_edge(2 * e.src + 1, t, INF);
+        flow.add_edge(2 * graph.src(i) + 1, t, INF);
     }
 
     min_cut = flow.max_flow(s, t);
+    flow_bytes = flow.memoryBytes();
     double optim_time = timer.getMsec();
     long obj_val = (long)min_cut * kr + (long)count_and * km;
 
@@ -55,3 +72,8 @@ long RelinearizeCutSolver::calcObjective(const int kr, const int km)
     assert(min_cut > 0);
     return (long)min_cut * kr + (long)count_and * km * 3;
 }
+
+size_t RelinearizeCutSolver::flowMemoryBytes() const
+{
+    return flow_bytes;
+}
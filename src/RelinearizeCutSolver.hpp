@@ -1,6 +1,8 @@
 #ifndef _FHE_RELIN_CUT_SOLVER
 #define _FHE_RELIN_CUT_SOLVER
 
+#include "ExternalGraph.hpp"
+#include "MaximumFlow.hpp"
 #include "RelinearizeSolver.hpp"
 #include "misc.hpp"
 
@@ -10,12 +12,27 @@ private:
     mytimer::timer timer = mytimer::timer();
     int min_cut = -1;
     int count_and = 0;
+    size_t flow_bytes = 0;
+    flow_engine engine;
+
+    template <class Graph>
+    ProblemResult solveGraph(const int kr, const int km, const Graph &graph,
+                             const int max_threads);
 
 public:
-    RelinearizeCutSolver(){};
+    // the max-flow runs with engine, on max_threads threads (0: all cores)
+    // for push-relabel on a large network (see MaximumFlow); sequential
+    // unless a thread count is given
+    RelinearizeCutSolver(const flow_engine _engine = FLOW_DINIC)
+      : engine(_engine){};
     ProblemResult solve(const int kr, const int km, const CircuitGraph &graph,
-                        const int max_threads = 0) override;
+                        const int max_threads = 1) override;
+    // the same on a mapped graph (the flow network is still in memory)
+    ProblemResult solve(const int kr, const int km, const ExternalGraph &graph,
+                        const int max_threads = 1);
     long calcObjective(const int kr, const int km);
+    // bytes of the max-flow network and engine of the last solve
+    size_t flowMemoryBytes() const;
 };
 
 #endif // _FHE_RELIN_CUT_SOLVER
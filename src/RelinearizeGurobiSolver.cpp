@@ -38,11 +38,7 @@ ProblemResult RelinearizeGurobiSolver::solve(const int kr, const int km,
         {
             sum_x += x[i];
         }
-        for (int i = 0; i < graph.n_gate; i++)
-            if (graph.gates[i].type == AND)
-            {
-                sum_mul += l[i] + x[i];
-            }
+        graph.forEachGate(AND, [&](int i) { sum_mul += l[i] + x[i]; });
         obj = kr * sum_x + km * sum_mul;
     }
     model.setObjective(obj, GRB_MINIMIZE);
@@ -50,10 +46,11 @@ ProblemResult RelinearizeGurobiSolver::solve(const int kr, const int km,
     // Set Constraints
     for (int i = 0; i < graph.n_gate; i++)
     {
-        int p1 = graph.wires[graph.gates[i].in1].src;
-        int p2 = graph.wires[graph.gates[i].in2].src;
+        const Gate g = graph.gate(i);
+        int p1 = graph.wires[g.in1].src;
+        int p2 = graph.wires[g.in2].src;
 
-        if (graph.gates[i].type == AND)
+        if (g.type == AND)
         {
             if (p1 != -1 && p2 != -1)
             {
@@ -72,21 +69,21 @@ ProblemResult RelinearizeGurobiSolver::solve(const int kr, const int km,
                 model.addConstr(l[i] == 2 + 2 - 1 - x[i]);
             }
         }
-        else if (graph.gates[i].type == XOR)
+        else if (g.type == XOR)
         {
             if (p1 != -1)
                 model.addConstr(l[i] >= l[p1] - x[i]);
             if (p2 != -1)
                 model.addConstr(l[i] >= l[p2] - x[i]);
         }
-        else if (graph.gates[i].type == INV)
+        else if (g.type == INV)
         {
             if (p1 != -1)
                 model.addConstr(l[i] == l[p1] - x[i]);
         }
 
         // if output var, dimension must 2
-        if (graph.gates[i].out >= graph.n_wire - graph.n_output)
+        if (g.out >= graph.n_wire - graph.n_output)
         {
             model.addConstr(l[i] == 2);
         }
@@ -104,11 +101,9 @@ ProblemResult RelinearizeGurobiSolver::solve(const int kr, const int km,
     {
         sumx += x[i].get(GRB_DoubleAttr_X);
     }
-    for (int i = 0; i < graph.n_gate; i++)
-        if (graph.gates[i].type == AND)
-        {
-            suml += l[i].get(GRB_DoubleAttr_X) + x[i].get(GRB_DoubleAttr_X);
-        }
+    graph.forEachGate(AND, [&](int i) {
+        suml += l[i].get(GRB_DoubleAttr_X) + x[i].get(GRB_DoubleAttr_X);
+    });
     // we can use these variables later
 
     return ProblemResult(obj_val, optim_time);
@@ -0,0 +1,165 @@
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "CircuitCache.hpp"
+#include "CircuitGraph.hpp"
+#include "CircuitPasses.hpp"
+#include "CircuitWriter.hpp"
+#include "ExternalGraph.hpp"
+#include "misc.hpp"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+
+    // Build argument parser and parse
+    const string HELP = "help";
+    const string CACHE_DIR = "cache-dir";
+    const string DESCRIPTION =
+      "convert a circuit (optionally reduced) into another format";
+    const string FORMAT = "format";
+    const string MEMORY = "memory";
+    const string NUM_THREAD = "num-thread";
+    const string OUTPUT = "output";
+    const string OUT_OF_CORE = "out-of-core";
+    const string REDUCE = "reduce";
+    const string SIMPLIFY = "simplify";
+    const string TMP_DIR = "tmp-dir";
+
+    cola::parser parser;
+    parser.define(HELP, "print this text and exit").alias('h');
+    parser.define(CACHE_DIR, "directory of circuit cache (none if empty).")
+      .alias('c')
+      .with_arg<string>("");
+    parser.define(FORMAT, "output format (bristol, fashion or binary).")
+      .alias('f')
+      .with_arg<string>("binary");
+    parser.define(OUTPUT, "output file name.").alias('o').with_arg<string>("");
+    parser.define(REDUCE, "write the reduced graph (reduceSize).").alias('r');
+    parser.define(SIMPLIFY, "shrink the circuit by the passes of "
+                            "CircuitPasses before writing.")
+      .alias('O');
+    parser.define(OUT_OF_CORE,
+                  "build the graph on disk (Bristol input only).")
+      .alias('x');
+    parser.define(MEMORY, "memory for out-of-core runs in MB.")
+      .alias('m')
+      .with_arg<int>(1024);
+    parser.define(TMP_DIR, "directory of out-of-core runs.")
+      .alias('t')
+      .with_arg<string>("/tmp");
+    parser.define(NUM_THREAD,
+                  "number of thread for reducing out-of-core (0: all cores).")
+      .alias('j')
+      .with_arg<int>(1);
+
+    parser.parse(argc, argv);
+
+    if (parser.is_passed(HELP))
+    {
+        parser.easy_usage(DESCRIPTION);
+        exit(0);
+    }
+
+    map<string, circuit_format> formats = {{"bristol", FORMAT_BRISTOL},
+                                           {"fashion", FORMAT_BRISTOL_FASHION},
+                                           {"binary", FORMAT_BINARY}};
+    auto format = formats.find(parser.get<string>(FORMAT));
+    if (format == formats.end())
+    {
+        cerr << "invalid format" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
+    string output_filename = parser.get<string>(OUTPUT);
+    vector<string> filenames = parser.rest_args();
+    if (output_filename.empty() || filenames.size() != 1)
+    {
+        cerr << "give one circuit file and an output file" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
+    CircuitCache cache(parser.get<string>(CACHE_DIR));
+    mytimer::timer timer;
+
+    if (parser.is_passed(OUT_OF_CORE) && parser.is_passed(SIMPLIFY))
+    {
+        cerr << "out-of-core circuits cannot be simplified" << endl;
+        exit(-1);
+    }
+
+    if (parser.is_passed(OUT_OF_CORE))
+    {
+        // the circuit is built into the output (binary) or a file aside
+        // that is reduced through a mapping
+        bool reduce = parser.is_passed(REDUCE);
+        if (!reduce && format->second != FORMAT_BINARY)
+        {
+            cerr << "out-of-core output is binary unless reduced" << endl;
+            exit(-1);
+        }
+        string tmp_dir = parser.get<string>(TMP_DIR);
+        string graph_filename =
+          reduce ? tmp_dir + "/convert-" + to_string(getpid()) + ".fcg"
+                 : output_filename;
+
+        timer.set();
+        ExternalGraph::build(filenames[0], graph_filename, tmp_dir,
+                             (size_t)parser.get<int>(MEMORY) << 20);
+        double build_ms = timer.getMsec();
+        ExternalGraph graph(graph_filename);
+        cout << filenames[0] << " -> " << graph_filename
+             << " (out-of-core) : |V|=" << graph.n_gate
+             << ", |E|=" << graph.n_wire << ", build " << build_ms << " ms"
+             << endl;
+        if (!reduce)
+            return 0;
+
+        timer.set();
+        CircuitGraph reduced =
+          CircuitGraph::reduceSize(graph, parser.get<int>(NUM_THREAD));
+        double reduce_ms = timer.getMsec();
+        remove(graph_filename.c_str());
+        CircuitWriter::write(output_filename, reduced, format->second);
+        cout << "reduced -> " << output_filename << " (" << format->first
+             << ") : |V|=" << reduced.n_gate << ", |E|=" << reduced.n_wire
+             << ", reduce " << reduce_ms << " ms" << endl;
+        return 0;
+    }
+
+    timer.set();
+    vector<CircuitGraph> loaded = cache.load(filenames[0]);
+    double load_ms = timer.getMsec();
+    if (parser.is_passed(SIMPLIFY))
+    {
+        timer.set();
+        vector<PassStats> stats;
+        loaded[0] = CircuitPasses::simplify(loaded[0], stats);
+        loaded[1] = loaded[0].reduceSize();
+        double simplify_ms = timer.getMsec();
+        for (const PassStats &s : stats)
+            cout << s.name << " : removed " << s.removed_gates << " gates, "
+                 << s.removed_edges << " edges" << endl;
+        cout << "simplify " << simplify_ms << " ms" << endl;
+    }
+    const CircuitGraph &graph = loaded[parser.is_passed(REDUCE) ? 1 : 0];
+
+    timer.set();
+    CircuitWriter::write(output_filename, graph, format->second);
+    double write_ms = timer.getMsec();
+
+    cout << filenames[0] << " -> " << output_filename << " (" << format->first
+         << ") : |V|=" << graph.n_gate << ", |E|=" << graph.n_wire
+         << ", load " << load_ms << " ms, write " << write_ms << " ms" << endl;
+
+    return 0;
+}
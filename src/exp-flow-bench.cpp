@@ -0,0 +1,193 @@
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "CircuitCache.hpp"
+#include "CircuitGraph.hpp"
+#include "MaximumFlow.hpp"
+#include "Parallel.hpp"
+#include "RelinearizeCutSolver.hpp"
+#include "misc.hpp"
+
+using namespace std;
+
+string fill_string(const string &str, int sz)
+{
+    return string(max(0, sz - (int)str.size()), ' ') + str;
+}
+
+// a random network of a few vertices with int capacities as in
+// RelinearizeCutSolver (small ones and INF), and several parallel INF edges
+// into t; s is 0 and t is 1. Returns the max-flow of every engine in
+// flowEngines() order, and in ref that of Dinic on long (-1 when it is INF
+// or more, beyond what int engines can tell)
+vector<int> randomFlows(const unsigned seed, long &ref)
+{
+    mt19937 rng(seed);
+    const int n = 3 + rng() % 20, m = rng() % (5 * n);
+    vector<tuple<int, int, int>> arcs;
+    for (int k = 0; k < m; k++)
+    {
+        const int from = rng() % n, to = rng() % n;
+        // INF only where RelinearizeCutSolver has it (not out of s)
+        const bool inf = from != 0 && rng() % 6 == 0;
+        arcs.emplace_back(from, to, inf ? INF : rng() % 20);
+    }
+    for (int k = 0; k < 2; k++)
+    {
+        const int v = 2 + rng() % (n - 2), c = 2 + rng() % 3;
+        for (int j = 0; j < c; j++)
+            arcs.emplace_back(v, 1, INF);
+    }
+
+    MaximumFlow<long> dinic(n);
+    for (auto &a : arcs)
+        dinic.add_edge(get<0>(a), get<1>(a), get<2>(a));
+    ref = dinic.max_flow(0, 1);
+    if (ref >= INF)
+        ref = -1;
+    vector<int> flows;
+    for (auto &e : flowEngines())
+    {
+        MaximumFlow<int> flow(n, e.second);
+        for (auto &a : arcs)
+            flow.add_edge(get<0>(a), get<1>(a), get<2>(a));
+        flows.push_back(flow.max_flow(0, 1));
+    }
+    return flows;
+}
+
+int main(int argc, char *argv[])
+{
+
+    // Build argument parser and parse
+    const string HELP = "help";
+    const string CACHE_DIR = "cache-dir";
+    const string DESCRIPTION =
+      "experiment to measure the time and memory of the max-flow engines on "
+      "the network of RelinearizeCutSolver";
+    const string NUM_TRIAL = "num-trial";
+    const string NUM_THREAD = "num-thread";
+    const string RANDOM = "random";
+
+    cola::parser parser;
+    parser.define(HELP, "print this text and exit").alias('h');
+    parser.define(CACHE_DIR, "directory of circuit cache (none if empty).")
+      .alias('c')
+      .with_arg<string>("");
+    parser.define(NUM_TRIAL, "number of trial for measuring time.")
+      .alias('n')
+      .with_arg<int>(1);
+    parser
+      .define(NUM_THREAD, "number of thread for the parallel push-relabel, "
+                          "measured too if not 1 (0: all cores).")
+      .alias('j')
+      .with_arg<int>(1);
+    parser.define(RANDOM, "number of random networks (with parallel INF "
+                          "edges into t) the engines are checked on first.")
+      .alias('r')
+      .with_arg<int>(10000);
+
+    parser.parse(argc, argv);
+
+    if (parser.is_passed(HELP))
+    {
+        parser.easy_usage(DESCRIPTION);
+        exit(0);
+    }
+
+    int num_trial = parser.get<int>(NUM_TRIAL);
+    if (num_trial <= 0)
+    {
+        cerr << "invalid number of trial" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+    int num_thread = parser.get<int>(NUM_THREAD);
+    if (num_thread < 0)
+    {
+        cerr << "invalid number of thread" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
+    // every engine gives the max-flow of Dinic
+    const int n_random = parser.get<int>(RANDOM);
+    for (int k = 0; k < n_random; k++)
+    {
+        long ref;
+        const vector<int> flows = randomFlows(k, ref);
+        for (size_t e = 0; ref != -1 && e < flows.size(); e++)
+            if (flows[e] != ref)
+            {
+                cerr << ioscc::red << "random network " << k << " : "
+                     << flowEngines()[e].first << " gives " << flows[e]
+                     << " instead of " << ref << endl;
+                exit(-1);
+            }
+    }
+    if (n_random > 0)
+        cout << fill_string("random networks", 45) << " : " << n_random
+             << " checked" << endl;
+
+    vector<string> filenames = parser.rest_args();
+    CircuitCache cache(parser.get<string>(CACHE_DIR));
+
+    // (name, engine, threads): the engines on one thread, then push-relabel
+    // on num_thread threads (parallel from MaximumFlow::PARALLEL_VERTICES
+    // vertices)
+    vector<tuple<string, flow_engine, int>> engines;
+    for (auto &e : flowEngines())
+        engines.emplace_back(e.first, e.second, 1);
+    if (num_thread != 1)
+    {
+        const string name =
+          "push-relabel/" + to_string(resolveThreads(num_thread));
+        engines.emplace_back(name, FLOW_PUSH_RELABEL, num_thread);
+    }
+
+    for (auto &f : filenames)
+    {
+        vector<CircuitGraph> loaded = cache.load(f);
+        const char *names[] = {"", " (reduced)"};
+        for (int k = 0; k < 2; k++)
+        {
+            const CircuitGraph &graph = loaded[k];
+            cout << fill_string(f + names[k], 45) << " : " << fixed
+                 << setprecision(2);
+
+            long objective = -1;
+            double first_ms = 0;
+            for (auto &e : engines)
+            {
+                RelinearizeCutSolver solver(get<1>(e));
+                double ms = 0;
+                for (int tt = 0; tt < num_trial; tt++)
+                {
+                    auto result = solver.solve(1, 1, graph, get<2>(e));
+                    ms += result.time_ms;
+                    if (objective == -1)
+                        objective = result.objective_value;
+                    if (result.objective_value != objective)
+                    {
+                        cerr << ioscc::red << f << " : " << get<0>(e)
+                             << " gives another cut" << endl;
+                        exit(-1);
+                    }
+                }
+                if (first_ms == 0)
+                    first_ms = ms;
+                cout << get<0>(e) << " " << ms / num_trial << " ms (x"
+                     << first_ms / ms << ", "
+                     << solver.flowMemoryBytes() / 1e6 << " MB), ";
+            }
+            cout << "cut+and=" << objective << ", |V|=" << graph.n_gate
+                 << ", depth=" << graph.andDepth() << endl;
+        }
+    }
+
+    return 0;
+}
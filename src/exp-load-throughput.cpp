@@ -0,0 +1,141 @@
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+#include "CompressedInput.hpp"
+#include "CircuitReader.hpp"
+#include "MappedFile.hpp"
+#include "misc.hpp"
+
+using namespace std;
+
+string fill_string(const string &str, int sz)
+{
+    return string(max(0, sz - (int)str.size()), ' ') + str;
+}
+
+// bytes the fan-outs of graph would take as one std::vector<int> per wire
+// (the layout before CircuitGraph::fanout): the vector itself and, for each
+// non-empty one, a heap block (glibc: 8 bytes of header, rounded up to 16,
+// 32 at least)
+size_t perWireFanoutBytes(const CircuitGraph &graph)
+{
+    size_t bytes = graph.wires.size() * sizeof(vector<int>);
+    for (size_t w = 0; w < graph.wires.size(); w++)
+    {
+        const size_t n = graph.dests(w).size();
+        if (n > 0)
+            bytes += max<size_t>(32, (4 * n + 8 + 15) / 16 * 16);
+    }
+    return bytes;
+}
+
+int main(int argc, char *argv[])
+{
+
+    // Build argument parser and parse
+    const string HELP = "help";
+    const string DESCRIPTION = "experiment to measure circuit load throughput";
+    const string NUM_THREAD = "num-thread";
+    const string NUM_TRIAL = "num-trial";
+
+    cola::parser parser;
+    parser.define(HELP, "print this text and exit").alias('h');
+    parser.define(NUM_THREAD, "number of thread for the parallel loader.")
+      .alias('j')
+      .with_arg<int>(0);
+    parser.define(NUM_TRIAL, "number of trial for measuring time.")
+      .alias('n')
+      .with_arg<int>(1);
+
+    parser.parse(argc, argv);
+
+    if (parser.is_passed(HELP))
+    {
+        parser.easy_usage(DESCRIPTION);
+        exit(0);
+    }
+
+    int num_trial = parser.get<int>(NUM_TRIAL);
+    if (num_trial <= 0)
+    {
+        cerr << "invalid number of trial" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
+    int num_thread = parser.get<int>(NUM_THREAD);
+    if (num_thread < 0)
+    {
+        cerr << "invalid number of thread" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
+    vector<string> filenames = parser.rest_args();
+
+    vector<pair<string, load_mode>> modes = {{"stream", LOAD_STREAM},
+                                             {"mmap", LOAD_MMAP},
+                                             {"parallel", LOAD_PARALLEL}};
+
+    mytimer::timer timer;
+
+    for (auto &circuit_filename : filenames)
+    {
+        MappedFile file(circuit_filename);
+        double mbytes = file.size() / 1e6;
+        // the stream loader reads plain Bristol only
+        bool bristol =
+          CompressedInput::detect(file) == COMPRESSION_NONE &&
+          CircuitReader::detectFormat(file) == FORMAT_BRISTOL;
+        CircuitGraph reference(circuit_filename,
+                               bristol ? LOAD_STREAM : LOAD_MMAP);
+
+        cout << fill_string(circuit_filename, 35) << " : " << fixed
+             << setprecision(2);
+
+        double base_time_ms = 0; // speedups are against the first loader
+        for (auto &m : modes)
+        {
+            if (m.second == LOAD_STREAM && !bristol)
+                continue;
+            double time_ms = 0;
+            for (int tt = 0; tt < num_trial; tt++)
+            {
+                timer.set();
+                CircuitGraph graph(circuit_filename, m.second, num_thread);
+                time_ms += timer.getMsec();
+                if (!(graph == reference))
+                {
+                    cerr << ioscc::red << m.first
+                         << " loader differs from reference loader" << endl;
+                    exit(-1);
+                }
+            }
+            time_ms /= num_trial;
+            if (base_time_ms == 0)
+                base_time_ms = time_ms;
+
+            cout << m.first << " " << time_ms << " ms ("
+                 << mbytes / time_ms * 1e3 << " MB/s, "
+                 << reference.n_gate / time_ms / 1e3 << " Mgates/s, x"
+                 << base_time_ms / time_ms << "), ";
+        }
+
+        const size_t fanout_bytes =
+          (reference.fanout_begin.size() + reference.fanout.size()) *
+          sizeof(int32_t);
+        cout << reference.memoryBytes() / 1e6 << " MB ("
+             << (perWireFanoutBytes(reference) - fanout_bytes) / 1e6
+             << " MB saved by fanout, ";
+        reference.packGates();
+        cout << reference.memoryBytes() / 1e6 << " MB packed), ";
+        cout << "|V|=" << reference.n_gate << ", |E|=" << reference.n_wire
+             << endl;
+    }
+
+    return 0;
+}
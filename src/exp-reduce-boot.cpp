@@ -1,11 +1,16 @@
 #include <cassert>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "BootstrapGurobiSolver.hpp"
+#include "CircuitBatchLoader.hpp"
+#include "CircuitCache.hpp"
+#include "CircuitDecomposition.hpp"
 #include "CircuitGraph.hpp"
+#include "CircuitPasses.hpp"
 #include "gurobi_c++.h"
 #include "misc.hpp"
 
@@ -21,12 +26,28 @@ int main(int argc, char *argv[])
 
     // Build argument parser and parse
     const string HELP = "help";
+    const string CACHE_DIR = "cache-dir";
+    const string DECOMPOSE = "decompose";
+    const string LOAD_QUEUE = "load-queue";
+    const string LOAD_THREAD = "load-thread";
     const string DESCRIPTION = "experiment to solve bootstrap problem";
     const string NUM_THREAD = "num-thread";
     const string NUM_TRIAL = "num-trial";
+    const string SIMPLIFY = "simplify";
+    const string SIZE_ONLY = "size-only";
 
     cola::parser parser;
     parser.define(HELP, "print this text and exit").alias('h');
+    parser.define(CACHE_DIR, "directory of circuit cache (none if empty).")
+      .alias('c')
+      .with_arg<string>("");
+    parser.define(LOAD_THREAD, "number of thread loading circuits ahead "
+                               "(all cores if 0).")
+      .alias('p')
+      .with_arg<int>(0);
+    parser.define(LOAD_QUEUE, "max number of circuits loaded ahead.")
+      .alias('q')
+      .with_arg<int>(4);
     parser.define(NUM_THREAD, "number of thread for gurobi.")
       .alias('j')
       .with_arg<int>(0);
@@ -37,6 +58,16 @@ int main(int argc, char *argv[])
     parser.define("L", "max level").with_arg<int>(2);
     parser.define("N", "noise after bootstrap").with_arg<int>(2);
 
+    parser.define(SIMPLIFY, "shrink circuits by the passes of CircuitPasses "
+                            "before solving.")
+      .alias('O');
+    parser.define(SIZE_ONLY, "solve the graph of reduceSize instead of "
+                             "reduceBootstrap.")
+      .alias('R');
+    parser.define(DECOMPOSE, "solve the weakly connected components apart, "
+                             "on -j threads (CircuitDecomposition).")
+      .alias('d');
+
     parser.parse(argc, argv);
 
     if (parser.is_passed(HELP))
@@ -61,7 +92,17 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+    int load_thread = parser.get<int>(LOAD_THREAD);
+    int load_queue = parser.get<int>(LOAD_QUEUE);
+    if (load_thread < 0 || load_queue <= 0)
+    {
+        cerr << "invalid number of load thread or load queue" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
     vector<string> filenames = parser.rest_args();
+    CircuitCache cache(parser.get<string>(CACHE_DIR));
 
     // prepare l,n for experiment
     // vector<pair<int,int>> ln = {{2,2}, {20,11}};
@@ -70,10 +111,52 @@ int main(int argc, char *argv[])
 
     BootstrapGurobiSolver ilpSolver;
 
-    for (auto &circuit_filename : filenames)
+    // with -d, the parts of a graph are solved on num_thread threads, by a
+    // solver each (gurobi on one thread)
+    const bool decompose = parser.is_passed(DECOMPOSE);
+    vector<unique_ptr<BootstrapGurobiSolver>> partSolvers;
+    for (int t = 0; decompose && t < resolveThreads(num_thread); t++)
+        partSolvers.emplace_back(new BootstrapGurobiSolver());
+    mytimer::timer timer;
+    auto solve = [&](const int l, const int n, const CircuitGraph &g)
+    {
+        if (!decompose)
+            return ilpSolver.solve(l, n, g, num_thread);
+        timer.set();
+        CircuitDecomposition parts(g);
+        long obj = parts.solveParts(
+          num_thread, [&](const int t, const CircuitGraph &part)
+          { return partSolvers[t]->solve(l, n, part, 1).objective_value; });
+        return ProblemResult(obj, timer.getMsec());
+    };
+
+    const bool simplify = parser.is_passed(SIMPLIFY);
+    const bool size_only = parser.is_passed(SIZE_ONLY);
+    CircuitBatchLoader loader(filenames,
+                              [&cache, simplify, size_only](const string &f) {
+                                  vector<CircuitGraph> graphs =
+                                    cache.load(f, !size_only);
+                                  if (simplify)
+                                  {
+                                      // the cache keeps the reduction of
+                                      // the file, not of the shrunk circuit
+                                      vector<PassStats> stats;
+                                      graphs[0] = CircuitPasses::simplify(
+                                        graphs[0], stats);
+                                      graphs[1] =
+                                        size_only
+                                          ? graphs[0].reduceSize()
+                                          : graphs[0].reduceBootstrap();
+                                  }
+                                  return graphs;
+                              },
+                              load_thread, load_queue);
+    string circuit_filename;
+    vector<CircuitGraph> loaded;
+
+    while (loader.next(circuit_filename, loaded))
     {
-        CircuitGraph graph(circuit_filename);
-        CircuitGraph reduced = graph.reduceSize();
+        const CircuitGraph &graph = loaded[0], &reduced = loaded[1];
 
         // double acc_original_optimize_time_ms = 0;
         // double acc_reduced_optimize_time_ms = 0;
@@ -88,9 +171,9 @@ int main(int argc, char *argv[])
             double org_optimize_time = 0, red_optimize_time = 0;
             for (int tt = 0; tt < num_trial; tt++)
             {
-                auto result = ilpSolver.solve(l, n, graph, num_thread);
+                auto result = solve(l, n, graph);
                 org_optimize_time += result.time_ms;
-                auto result2 = ilpSolver.solve(l, n, reduced, num_thread);
+                auto result2 = solve(l, n, reduced);
                 red_optimize_time += result2.time_ms;
                 if (result.objective_value != result2.objective_value)
                 {
@@ -4,7 +4,10 @@
 #include <string>
 #include <vector>
 
+#include "CircuitBatchLoader.hpp"
+#include "CircuitCache.hpp"
 #include "CircuitGraph.hpp"
+#include "CircuitPasses.hpp"
 #include "RelinearizeGurobiSolver.hpp"
 #include "gurobi_c++.h"
 #include "misc.hpp"
@@ -21,12 +24,26 @@ int main(int argc, char *argv[])
 
     // Build argument parser and parse
     const string HELP = "help";
+    const string CACHE_DIR = "cache-dir";
+    const string LOAD_QUEUE = "load-queue";
+    const string LOAD_THREAD = "load-thread";
     const string DESCRIPTION = "relinearize problem solving experiment code";
     const string NUM_THREAD = "num-thread";
     const string NUM_TRIAL = "num-trial";
+    const string SIMPLIFY = "simplify";
 
     cola::parser parser;
     parser.define(HELP, "print this text and exit").alias('h');
+    parser.define(CACHE_DIR, "directory of circuit cache (none if empty).")
+      .alias('c')
+      .with_arg<string>("");
+    parser.define(LOAD_THREAD, "number of thread loading circuits ahead "
+                               "(all cores if 0).")
+      .alias('p')
+      .with_arg<int>(0);
+    parser.define(LOAD_QUEUE, "max number of circuits loaded ahead.")
+      .alias('q')
+      .with_arg<int>(4);
     parser.define(NUM_THREAD, "number of thread for gurobi.")
       .alias('j')
       .with_arg<int>(0);
@@ -34,6 +51,10 @@ int main(int argc, char *argv[])
       .alias('n')
       .with_arg<int>(1);
 
+    parser.define(SIMPLIFY, "shrink circuits by the passes of CircuitPasses "
+                            "before solving.")
+      .alias('O');
+
     parser.parse(argc, argv);
 
     if (parser.is_passed(HELP))
@@ -58,7 +79,17 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+    int load_thread = parser.get<int>(LOAD_THREAD);
+    int load_queue = parser.get<int>(LOAD_QUEUE);
+    if (load_thread < 0 || load_queue <= 0)
+    {
+        cerr << "invalid number of load thread or load queue" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
     vector<string> filenames = parser.rest_args();
+    CircuitCache cache(parser.get<string>(CACHE_DIR));
 
     // prepare kr,km for experiment
     vector<pair<int, int>> rm = {{10, 1}, {5, 1}, {3, 1}, {2, 1}, {1, 1},
@@ -70,10 +101,26 @@ int main(int argc, char *argv[])
     RelinearizeGurobiSolver ilpSolver;
     // RelinearizeCutSolver cutSolver;
 
-    for (auto &circuit_filename : filenames)
+    const bool simplify = parser.is_passed(SIMPLIFY);
+    CircuitBatchLoader loader(filenames,
+                              [&cache, simplify](const string &f) {
+                                  vector<CircuitGraph> graphs = cache.load(f);
+                                  if (simplify)
+                                  {
+                                      vector<PassStats> stats;
+                                      graphs[0] = CircuitPasses::simplify(
+                                        graphs[0], stats);
+                                      graphs[1] = graphs[0].reduceSize();
+                                  }
+                                  return graphs;
+                              },
+                              load_thread, load_queue);
+    string circuit_filename;
+    vector<CircuitGraph> loaded;
+
+    while (loader.next(circuit_filename, loaded))
     {
-        CircuitGraph graph(circuit_filename);
-        CircuitGraph reduced = graph.reduceSize();
+        const CircuitGraph &graph = loaded[0], &reduced = loaded[1];
 
         double acc_original_optimize_time_ms = 0;
         double acc_reduced_optimize_time_ms = 0;
@@ -0,0 +1,248 @@
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CircuitGraph.hpp"
+#include "Parallel.hpp"
+#include "ReductionMap.hpp"
+#include "misc.hpp"
+
+using namespace std;
+
+string fill_string(const string &str, int sz)
+{
+    return string(max(0, sz - (int)str.size()), ' ') + str;
+}
+
+// writes a random Bristol circuit of n_gate gates (30% AND, 55% XOR, 15% INV)
+// whose inputs are taken from the last `window` wires, so that the depth
+// grows with the size as in real circuits; returns false on a write error
+bool writeSynthetic(const string &filename, const int n_gate,
+                    const unsigned seed)
+{
+    const int window = 1000;
+    const int n_input = max(2, n_gate / 100), n_output = max(1, n_gate / 100);
+    FILE *fp = fopen(filename.c_str(), "w");
+    if (fp == nullptr)
+        return false;
+    fprintf(fp, "%d %d\n%d 0 %d\n\n", n_gate, n_input + n_gate, n_input,
+            n_output);
+
+    mt19937 rng(seed);
+    for (int i = 0; i < n_gate; i++)
+    {
+        const int top = n_input + i; // wires [0, top) are driven already
+        uniform_int_distribution<int> pick(max(0, top - window), top - 1);
+        const int kind = rng() % 100;
+        if (kind < 15)
+            fprintf(fp, "1 1 %d %d INV\n", pick(rng), top);
+        else
+            fprintf(fp, "2 1 %d %d %d %s\n", pick(rng), pick(rng), top,
+                    kind < 45 ? "AND" : "XOR");
+    }
+    return fclose(fp) == 0;
+}
+
+// the first invariant of the map of graph to reduced that does not hold
+// (empty if none): the members of the reduced gates (wires) are a partition
+// of the original ones and include the representative, an AND gate is
+// reduced to an AND gate, and a reduced wire is that of its representative
+string checkMap(const CircuitGraph &graph, const CircuitGraph &reduced,
+                const ReductionMap &map)
+{
+    if (map.originalGates() != graph.n_gate ||
+        map.reducedGates() != reduced.n_gate)
+        return "the map has other sizes than the graphs";
+
+    vector<char> seen(graph.n_gate, 0);
+    for (int v = 0; v < reduced.n_gate; v++)
+    {
+        for (const int i : map.gatesOf(v))
+        {
+            if (map.reducedGate(i) != v || seen[i])
+                return "the members of gate " + to_string(v) +
+                       " are not a part of the gates";
+            seen[i] = 1;
+        }
+        if (map.reducedGate(map.originalGate(v)) != v)
+            return "the representative of gate " + to_string(v) +
+                   " is not a member";
+    }
+    for (int i = 0; i < graph.n_gate; i++)
+    {
+        if (!seen[i])
+            return "gate " + to_string(i) + " is not a member";
+        if (graph.gate(i).type == AND &&
+            reduced.gate(map.reducedGate(i)).type != AND)
+            return "AND gate " + to_string(i) + " is reduced to a non-AND";
+    }
+
+    seen.assign(graph.n_wire, 0);
+    for (int e = 0; e < reduced.n_wire; e++)
+    {
+        for (const int w : map.wiresOf(e))
+        {
+            if (map.reducedWire(w) != e || seen[w])
+                return "the members of wire " + to_string(e) +
+                       " are not a part of the wires";
+            seen[w] = 1;
+        }
+        if (map.reducedWire(map.originalWire(e)) != e)
+            return "the representative of wire " + to_string(e) +
+                   " is reduced to another wire";
+    }
+    for (int w = 0; w < graph.n_wire; w++)
+        if (!seen[w])
+            return "wire " + to_string(w) + " is not a member";
+    return "";
+}
+
+int main(int argc, char *argv[])
+{
+
+    // Build argument parser and parse
+    const string HELP = "help";
+    const string DESCRIPTION =
+      "experiment to measure reduceSize against the former implementation "
+      "and on several threads";
+    const string MAX_GATES = "max-gates";
+    const string NUM_THREAD = "num-thread";
+    const string NUM_TRIAL = "num-trial";
+    const string SEED = "seed";
+    const string TMP_DIR = "tmp-dir";
+
+    cola::parser parser;
+    parser.define(HELP, "print this text and exit").alias('h');
+    parser.define(MAX_GATES,
+                  "synthetic circuits of 10^4 .. max-gates gates "
+                  "(none if 0; only the given circuit files then).")
+      .alias('g')
+      .with_arg<int>(10000000);
+    parser.define(NUM_THREAD, "number of thread for the parallel reduceSize.")
+      .alias('j')
+      .with_arg<int>(0);
+    parser.define(NUM_TRIAL, "number of trial for measuring time.")
+      .alias('n')
+      .with_arg<int>(1);
+    parser.define(SEED, "seed of the synthetic circuits.")
+      .alias('s')
+      .with_arg<int>(1);
+    parser.define(TMP_DIR, "directory of the synthetic circuits.")
+      .alias('t')
+      .with_arg<string>("/tmp");
+
+    parser.parse(argc, argv);
+
+    if (parser.is_passed(HELP))
+    {
+        parser.easy_usage(DESCRIPTION);
+        exit(0);
+    }
+
+    int num_trial = parser.get<int>(NUM_TRIAL);
+    if (num_trial <= 0)
+    {
+        cerr << "invalid number of trial" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+    int num_thread = resolveThreads(parser.get<int>(NUM_THREAD));
+
+    // (name, file)
+    vector<pair<string, string>> circuits;
+    vector<string> tmp_files;
+    for (long n = 10000; n <= parser.get<int>(MAX_GATES); n *= 10)
+    {
+        string tmp = parser.get<string>(TMP_DIR) + "/reduce-bench-XXXXXX";
+        int fd = mkstemp(&tmp[0]);
+        if (fd < 0 || !writeSynthetic(tmp, n, parser.get<int>(SEED)))
+        {
+            cerr << "cannot write a synthetic circuit to " << tmp << endl;
+            exit(-1);
+        }
+        close(fd);
+        circuits.push_back({"synthetic-" + to_string(n), tmp});
+        tmp_files.push_back(tmp);
+    }
+    for (auto &f : parser.rest_args())
+        circuits.push_back({f, f});
+
+    mytimer::timer timer;
+
+    for (auto &c : circuits)
+    {
+        CircuitGraph graph(c.second);
+
+        // the maps of reduceSize (on one and on num_thread threads) and
+        // reduceBootstrap, checked once (not timed)
+        ReductionMap map, parallel_map, boot_map;
+        const CircuitGraph mapped[] = {graph.reduceSize(map),
+                                       graph.reduceSize(parallel_map,
+                                                        num_thread),
+                                       graph.reduceBootstrap(boot_map)};
+        const ReductionMap *maps[] = {&map, &parallel_map, &boot_map};
+        const char *names[] = {"reduceSize", "parallel reduceSize",
+                               "reduceBootstrap"};
+        for (int k = 0; k < 3; k++)
+        {
+            const string broken = checkMap(graph, mapped[k], *maps[k]);
+            if (!broken.empty())
+            {
+                cerr << ioscc::red << c.first << " : map of " << names[k]
+                     << " : " << broken << endl;
+                exit(-1);
+            }
+        }
+
+        double legacy_ms = 0, linear_ms = 0, parallel_ms = 0;
+        for (int tt = 0; tt < num_trial; tt++)
+        {
+            timer.set();
+            CircuitGraph legacy = CircuitGraph::reduceSizeLegacy(graph);
+            legacy_ms += timer.getMsec();
+
+            timer.set();
+            CircuitGraph reduced = CircuitGraph::reduceSize(graph);
+            linear_ms += timer.getMsec();
+
+            timer.set();
+            CircuitGraph parallel = CircuitGraph::reduceSize(graph, num_thread);
+            parallel_ms += timer.getMsec();
+
+            if (!(legacy == reduced))
+            {
+                cerr << ioscc::red << c.first
+                     << " : reduceSize differs from the former one" << endl;
+                exit(-1);
+            }
+            if (!(parallel == reduced))
+            {
+                cerr << ioscc::red << c.first
+                     << " : the parallel reduceSize differs" << endl;
+                exit(-1);
+            }
+            if (tt + 1 == num_trial)
+            {
+                cout << fill_string(c.first, 35) << " : " << fixed
+                     << setprecision(2) << "legacy "
+                     << legacy_ms / num_trial << " ms, linear "
+                     << linear_ms / num_trial << " ms (x"
+                     << legacy_ms / linear_ms << "), " << num_thread
+                     << " threads " << parallel_ms / num_trial << " ms (x"
+                     << linear_ms / parallel_ms << "), |V|=" << graph.n_gate
+                     << " -> " << reduced.n_gate << endl;
+            }
+        }
+    }
+
+    for (auto &f : tmp_files)
+        unlink(f.c_str());
+
+    return 0;
+}
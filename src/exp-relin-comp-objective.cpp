@@ -4,7 +4,10 @@
 #include <string>
 #include <vector>
 
+#include "CircuitBatchLoader.hpp"
+#include "CircuitCache.hpp"
 #include "CircuitGraph.hpp"
+#include "CircuitPasses.hpp"
 #include "RelinearizeCutSolver.hpp"
 #include "RelinearizeGurobiSolver.hpp"
 #include "gurobi_c++.h"
@@ -22,18 +25,42 @@ int main(int argc, char *argv[])
 
     // Build argument parser and parse
     const string HELP = "help";
+    const string CACHE_DIR = "cache-dir";
+    const string FLOW_ENGINE = "flow-engine";
+    const string LOAD_QUEUE = "load-queue";
+    const string LOAD_THREAD = "load-thread";
     const string PARAM_KR = "kr";
     const string PARAM_KM = "km";
+    const string SIMPLIFY = "simplify";
     const string DESCRIPTION = "relinearize problem solving experiment code";
 
     cola::parser parser;
     parser.define(HELP, "print this text and exit").alias('h');
+    parser.define(CACHE_DIR, "directory of circuit cache (none if empty).")
+      .alias('c')
+      .with_arg<string>("");
+    parser.define(LOAD_THREAD, "number of thread loading circuits ahead "
+                               "(all cores if 0).")
+      .alias('p')
+      .with_arg<int>(0);
+    parser.define(LOAD_QUEUE, "max number of circuits loaded ahead.")
+      .alias('q')
+      .with_arg<int>(4);
     parser.define(PARAM_KR, "k_r of relinearize problem")
       .alias('r')
       .with_arg<int>();
     parser.define(PARAM_KM, "k_m of relinearize problem")
       .alias('m')
       .with_arg<int>();
+    parser.define(SIMPLIFY, "shrink circuits by the passes of CircuitPasses "
+                            "before solving.")
+      .alias('O');
+
+    parser.define(FLOW_ENGINE, "max-flow engine of the cut solver (dinic, "
+                               "push-relabel, bk or pseudoflow).")
+      .alias('e')
+      .with_arg<string>("dinic");
+
     parser.parse(argc, argv);
 
     if (parser.is_passed(HELP))
@@ -42,7 +69,37 @@ int main(int argc, char *argv[])
         exit(0);
     }
 
+    flow_engine engine = FLOW_DINIC;
+    {
+        string name = parser.get<string>(FLOW_ENGINE);
+        bool found = false;
+        for (auto &e : flowEngines())
+            if (e.first == name)
+            {
+                engine = e.second;
+                found = true;
+            }
+        if (!found)
+        {
+            cerr << "invalid flow engine" << endl;
+            parser.easy_usage(DESCRIPTION);
+            exit(-1);
+        }
+    }
+
+    int load_thread = parser.get<int>(LOAD_THREAD);
+    int load_queue = parser.get<int>(LOAD_QUEUE);
+    if (load_thread < 0 || load_queue <= 0)
+    {
+        cerr << "invalid number of load thread or load queue" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
+
     vector<string> filenames = parser.rest_args();
+    string cache_dir = parser.get<string>(CACHE_DIR);
+    CircuitCache cache(cache_dir);
+    bool simplify = parser.is_passed(SIMPLIFY);
 
     // prepare kr,km for experiment
     vector<pair<int, int>> rm = {{10, 1}, {5, 1}, {3, 1}, {2, 1}, {1, 1}};
@@ -55,12 +112,31 @@ int main(int argc, char *argv[])
         rm = {{parser.get<int>(PARAM_KM), parser.get<int>(PARAM_KR)}};
     }
 
-    RelinearizeCutSolver cutSolver;
+    RelinearizeCutSolver cutSolver(engine);
     RelinearizeGurobiSolver ilpSolver;
 
-    for (auto &circuit_filename : filenames)
+    CircuitBatchLoader loader(filenames,
+                              [&](const string &f) {
+                                  vector<CircuitGraph> graphs;
+                                  if (cache_dir.empty())
+                                      graphs.emplace_back(f);
+                                  else
+                                      graphs = cache.load(f);
+                                  if (simplify)
+                                  {
+                                      vector<PassStats> stats;
+                                      graphs[0] = CircuitPasses::simplify(
+                                        graphs[0], stats);
+                                  }
+                                  return graphs;
+                              },
+                              load_thread, load_queue);
+    string circuit_filename;
+    vector<CircuitGraph> loaded;
+
+    while (loader.next(circuit_filename, loaded))
     {
-        CircuitGraph graph(circuit_filename);
+        const CircuitGraph &graph = loaded[0];
 
         cutSolver.solve(1, 1, graph);
 
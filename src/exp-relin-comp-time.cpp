@@ -1,10 +1,15 @@
 #include <cassert>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "CircuitBatchLoader.hpp"
+#include "CircuitCache.hpp"
+#include "CircuitDecomposition.hpp"
 #include "CircuitGraph.hpp"
+#include "CircuitPasses.hpp"
 #include "RelinearizeCutSolver.hpp"
 #include "RelinearizeGurobiSolver.hpp"
 #include "gurobi_c++.h"
@@ -22,18 +27,50 @@ int main(int argc, char *argv[])
 
     // Build argument parser and parse
     const string HELP = "help";
+    const string CACHE_DIR = "cache-dir";
+    const string DECOMPOSE = "decompose";
+    const string FLOW_ENGINE = "flow-engine";
+    const string LOAD_QUEUE = "load-queue";
+    const string LOAD_THREAD = "load-thread";
     const string DESCRIPTION = "relinearize problem solving experiment code";
     const string NUM_THREAD = "num-thread";
     const string NUM_TRIAL = "num-trial";
+    const string PACKED = "packed";
+    const string SIMPLIFY = "simplify";
 
     cola::parser parser;
     parser.define(HELP, "print this text and exit").alias('h');
-    parser.define(NUM_THREAD, "number of thread for gurobi.")
+    parser.define(CACHE_DIR, "directory of circuit cache (none if empty).")
+      .alias('c')
+      .with_arg<string>("");
+    parser.define(LOAD_THREAD, "number of thread loading circuits ahead "
+                               "(all cores if 0).")
+      .alias('p')
+      .with_arg<int>(0);
+    parser.define(LOAD_QUEUE, "max number of circuits loaded ahead.")
+      .alias('q')
+      .with_arg<int>(4);
+    parser.define(NUM_THREAD, "number of thread for gurobi, and for the "
+                              "push-relabel max-flow if given.")
       .alias('j')
       .with_arg<int>(0);
     parser.define(NUM_TRIAL, "number of trial for measuring time.")
       .alias('n')
       .with_arg<int>(1);
+    parser.define(PACKED, "store gates as a structure of arrays.")
+      .alias('s');
+
+    parser.define(SIMPLIFY, "shrink circuits by the passes of CircuitPasses "
+                            "before solving.")
+      .alias('O');
+    parser.define(DECOMPOSE, "solve the weakly connected components apart, "
+                             "on -j threads (CircuitDecomposition).")
+      .alias('d');
+
+    parser.define(FLOW_ENGINE, "max-flow engine of the cut solver (dinic, "
+                               "push-relabel, bk or pseudoflow).")
+      .alias('e')
+      .with_arg<string>("dinic");
 
     parser.parse(argc, argv);
 
@@ -58,8 +95,41 @@ int main(int argc, char *argv[])
         parser.easy_usage(DESCRIPTION);
         exit(-1);
     }
+    // the cut stays sequential, as the baseline, unless -j is given
+    const int cut_thread = parser.is_passed(NUM_THREAD) ? num_thread : 1;
+
+    flow_engine engine = FLOW_DINIC;
+    {
+        string name = parser.get<string>(FLOW_ENGINE);
+        bool found = false;
+        for (auto &e : flowEngines())
+            if (e.first == name)
+            {
+                engine = e.second;
+                found = true;
+            }
+        if (!found)
+        {
+            cerr << "invalid flow engine" << endl;
+            parser.easy_usage(DESCRIPTION);
+            exit(-1);
+        }
+    }
+
+    int load_thread = parser.get<int>(LOAD_THREAD);
+    int load_queue = parser.get<int>(LOAD_QUEUE);
+    if (load_thread < 0 || load_queue <= 0)
+    {
+        cerr << "invalid number of load thread or load queue" << endl;
+        parser.easy_usage(DESCRIPTION);
+        exit(-1);
+    }
 
     vector<string> filenames = parser.rest_args();
+    string cache_dir = parser.get<string>(CACHE_DIR);
+    CircuitCache cache(cache_dir);
+    bool packed = parser.is_passed(PACKED);
+    bool simplify = parser.is_passed(SIMPLIFY);
 
     // prepare kr,km for experiment
     vector<pair<int, int>> rm = {{10, 1}, {5, 1}, {3, 1}, {2, 1}, {1, 1},
@@ -70,19 +140,81 @@ int main(int argc, char *argv[])
 
     try
     {
-        RelinearizeCutSolver cutSolver;
+        RelinearizeCutSolver cutSolver(engine);
         RelinearizeGurobiSolver ilpSolver;
 
-        for (auto &circuit_filename : filenames)
+        // with -d, the parts of a graph are solved on num_thread threads, by
+        // a solver each (gurobi and the max-flow on one thread)
+        const bool decompose = parser.is_passed(DECOMPOSE);
+        const int part_threads = decompose ? resolveThreads(num_thread) : 0;
+        vector<RelinearizeCutSolver> partCutSolvers(
+          part_threads, RelinearizeCutSolver(engine));
+        vector<unique_ptr<RelinearizeGurobiSolver>> partIlpSolvers;
+        for (int t = 0; t < part_threads; t++)
+            partIlpSolvers.emplace_back(new RelinearizeGurobiSolver());
+        mytimer::timer timer;
+        auto solveCut = [&](const CircuitGraph &g)
+        {
+            if (!decompose)
+                return cutSolver.solve(1, 1, g, cut_thread);
+            timer.set();
+            CircuitDecomposition parts(g);
+            long obj = parts.solveParts(
+              num_thread, [&](const int t, const CircuitGraph &part)
+              {
+                  return partCutSolvers[t]
+                    .solve(1, 1, part, 1)
+                    .objective_value;
+              });
+            return ProblemResult(obj, timer.getMsec());
+        };
+        auto solveIlp = [&](const int kr, const int km, const CircuitGraph &g)
+        {
+            if (!decompose)
+                return ilpSolver.solve(kr, km, g, num_thread);
+            timer.set();
+            CircuitDecomposition parts(g);
+            long obj = parts.solveParts(
+              num_thread, [&](const int t, const CircuitGraph &part)
+              {
+                  return partIlpSolvers[t]
+                    ->solve(kr, km, part, 1)
+                    .objective_value;
+              });
+            return ProblemResult(obj, timer.getMsec());
+        };
+
+        CircuitBatchLoader loader(filenames,
+                                  [&](const string &f) {
+                                      vector<CircuitGraph> graphs;
+                                      if (cache_dir.empty())
+                                          graphs.emplace_back(f);
+                                      else
+                                          graphs = cache.load(f);
+                                      if (simplify)
+                                      {
+                                          vector<PassStats> stats;
+                                          graphs[0] = CircuitPasses::simplify(
+                                            graphs[0], stats);
+                                      }
+                                      if (packed)
+                                          graphs[0].packGates();
+                                      return graphs;
+                                  },
+                                  load_thread, load_queue);
+        string circuit_filename;
+        vector<CircuitGraph> loaded;
+
+        while (loader.next(circuit_filename, loaded))
         {
-            CircuitGraph graph(circuit_filename);
+            const CircuitGraph &graph = loaded[0];
 
             double acc_approx_optimize_time_ms = 0;
             double acc_optimize_time_ms = 0;
 
             for (int tt = 0; tt < num_trial; tt++)
             {
-                auto result = cutSolver.solve(1, 1, graph);
+                auto result = solveCut(graph);
                 acc_approx_optimize_time_ms += result.time_ms;
             }
 
@@ -96,7 +228,7 @@ int main(int argc, char *argv[])
                 double optimize_time = 0;
                 for (int tt = 0; tt < num_trial; tt++)
                 {
-                    auto result = ilpSolver.solve(kr, km, graph, num_thread);
+                    auto result = solveIlp(kr, km, graph);
                     optimize_time += result.time_ms;
                 }
                 cout << optimize_time / num_trial << ", ";